@@ -1,4 +1,4 @@
-// g++ -O2 -o wallet wallet.cpp libdb.a libsqlite3.a
+// g++ -O2 -pthread -o wallet wallet.cpp libdb.a libsqlite3.a
 /*Author: 8891689
  * Assist in creation ：gemini
  */
@@ -17,9 +17,59 @@
 #include <iomanip>
 #include <map>
 #include <system_error>
+#include <fstream>
+#include <thread>
+#include <atomic>
+#include <mutex>
+#include <cstdlib>
+#include <climits>
+#include <unordered_set>
+#include <chrono>
+#include <functional>
+#include <condition_variable>
+#include <memory>
+#include <sys/stat.h>
+#include <sys/resource.h>
+#include <sys/inotify.h>
+#include <poll.h>
+#include <signal.h>
+#include <unistd.h>
+#include <deque>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/mman.h>
+#include <fcntl.h>
+#include <sys/ioctl.h>
+#include <linux/fs.h>
+#include <linux/fiemap.h>
+
+// --- Static Tracepoints ---
+// USDT probes (provider "wallet") for bpftrace/perf; see probes/*.bt. An enabled probe is a single nop until
+// a tracer attaches. Without <sys/sdt.h> (systemtap-sdt-dev) they compile to nothing and their arguments are
+// never evaluated.
+#if defined(__has_include)
+#if __has_include(<sys/sdt.h>)
+#include <sys/sdt.h>
+#define WALLET_PROBE(name, ...) STAP_PROBEV(wallet, name, ##__VA_ARGS__)
+#endif
+#endif
+#ifndef WALLET_PROBE
+template <typename... Args> static inline void wallet_probe_args(const Args&...) {}
+#define WALLET_PROBE(name, ...) do { if (false) wallet_probe_args(__VA_ARGS__); } while (0)
+#endif
+
+// wallet_bench.cpp builds this file together with the other program: WALLET_NAMESPACE keeps the two sets of
+// definitions apart and WALLET_NO_MAIN drops main(). Headers are included above, outside the namespace.
+#ifdef WALLET_NAMESPACE
+namespace WALLET_NAMESPACE {
+#endif
 
 // --- Constants and Error Class ---
 const size_t MAX_BUFFER_SIZE = 4 * 1024 * 1024; // 4MB limit for record size
+#define EVIDENCE_MMAP_SIZE "268435456" // 256MB SQLite mmap window for immutable opens (--evidence, --triage)
+
+// --evidence: open SQLite wallets immutable/lock-free and never fall back to a writable open
+static bool g_evidence_mode = false;
 
 class SerializationError : public std::runtime_error {
 public:
@@ -36,8 +86,28 @@ struct MKeyData {
 };
 // Type alias for the in-memory map
 using WalletDataMap = std::map<std::vector<uint8_t>, std::vector<uint8_t>>;
+// Called once per record by the readers; return false to stop reading early
+using RecordVisitor = std::function<bool(const uint8_t* key, size_t key_len, const uint8_t* value, size_t value_len)>;
 // Enum to indicate the source database type
 enum class DbSourceType { UNKNOWN, BDB, SQLITE_SPECIAL };
+// Per-file result of an extraction
+enum class ExtractStatus { OK, EXCLUDED, OPEN_FAILED, NOT_A_WALLET, READ_FAILED, TRUNCATED_RECORD, NO_MKEY, INVALID_MKEY, UNSUPPORTED_METHOD };
+const size_t EXTRACT_STATUS_COUNT = static_cast<size_t>(ExtractStatus::UNSUPPORTED_METHOD) + 1;
+
+static const char* extract_status_name(ExtractStatus status) {
+    switch (status) {
+        case ExtractStatus::OK:                 return "ok";
+        case ExtractStatus::EXCLUDED:           return "excluded";
+        case ExtractStatus::OPEN_FAILED:        return "open_failed";
+        case ExtractStatus::NOT_A_WALLET:       return "not_a_wallet";
+        case ExtractStatus::READ_FAILED:        return "read_failed";
+        case ExtractStatus::TRUNCATED_RECORD:   return "truncated_record";
+        case ExtractStatus::NO_MKEY:            return "no_mkey";
+        case ExtractStatus::INVALID_MKEY:       return "invalid_mkey";
+        case ExtractStatus::UNSUPPORTED_METHOD: return "unsupported_method";
+    }
+    return "unknown";
+}
 
 // --- BCDataStream Class Definition ---
 class BCDataStream {
@@ -98,82 +168,247 @@ public:
 
 // --- Utility Function DECLARATION ---
 static std::string toHex(const std::vector<uint8_t>& data);
+static bool has_dat_extension(const std::string& name);
+static bool collect_dat_files(const char* dir, std::vector<std::string>& files);
 
 // --- Core Function DECLARATIONS (Prototypes) ---
+bool visit_bdb_records(const char* walletfile, const RecordVisitor& visit);
+bool visit_sqlite_records(const char* walletfile, const RecordVisitor& visit);
 bool read_all_bdb(const char* walletfile, WalletDataMap& data_map);
 bool read_all_sqlite_special(const char* walletfile, WalletDataMap& data_map);
+bool choose_and_visit_records(const char* walletfile, const RecordVisitor& visit, DbSourceType& source_type);
 bool choose_and_read_all_data(const char* walletfile, WalletDataMap& data_map, DbSourceType& source_type);
 bool find_and_parse_mkey(const WalletDataMap& data_map, DbSourceType source_type, MKeyData& mkey_data);
-void extract_and_print_hash(const char* filename);
+ExtractStatus extract_mkey(const char* filename, MKeyData& mkey);
+bool is_excluded_hash(const MKeyData& mkey);
+std::string format_hash(const MKeyData& mkey);
+ExtractStatus extract_and_print_hash(const char* filename, std::ostream& out, std::mutex& out_mutex);
+int verify_passphrases(const std::vector<std::string>& files, const char* passphrase_file, unsigned threads, std::ostream& out);
+int write_iteration_buckets(const std::vector<std::string>& files, const std::string& prefix, const std::vector<uint32_t>& bounds);
+int merge_shard_outputs(const std::vector<std::string>& inputs, const std::string& output);
+int watch_directory(const std::string& dir, unsigned threads, int debounce_ms, const std::function<void(const std::string&)>& process,
+                    const std::function<void()>& idle);
+int serve_unix_socket(const std::string& socket_path, unsigned threads);
+int binary_hashlist_to_text(const char* file, std::ostream& out);
+int triage_wallets(const std::vector<std::string>& files, unsigned threads, std::ostream& out);
+
+// --- Diagnostics ---
+// Messages about one file are collected in a thread-local buffer and written to STDERR as whole lines with
+// one write() when the file is done, instead of a separate unbuffered write per "<<" piece. Outside a file
+// scope diag() is plain std::cerr. Each finished file is counted by status for the end-of-run summary;
+// failures can also be appended to a JSONL error log (--error-log).
+static thread_local std::ostringstream* t_diag = nullptr;
+static thread_local ExtractStatus t_failure = ExtractStatus::READ_FAILED; // Why the last read on this thread failed
+static thread_local uint64_t t_file_size = 0; // Size extract_mkey saw for the current file (for the progress meter)
+
+static std::ostream& diag() { return t_diag ? static_cast<std::ostream&>(*t_diag) : std::cerr; }
+
+// Records the class of a read failure; the first cause found wins
+static void note_failure(ExtractStatus status) {
+    if (t_failure == ExtractStatus::READ_FAILED) t_failure = status;
+}
+
+// libdb reports some errors itself; route them through the same channel
+static void bdb_error_callback(const DB_ENV*, const char* prefix, const char* msg) {
+    if (prefix) diag() << prefix << ": ";
+    diag() << msg << std::endl;
+}
+
+static bool write_all(int fd, const std::string& data) {
+    size_t done = 0;
+    while (done < data.size()) {
+        ssize_t n = write(fd, data.data() + done, data.size() - done);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) return false;
+        done += static_cast<size_t>(n);
+    }
+    return true;
+}
+
+static std::string json_escape(const std::string& s) {
+    std::string out;
+    out.reserve(s.size() + 8);
+    for (unsigned char c : s) {
+        if (c == '"' || c == '\\') { out += '\\'; out += static_cast<char>(c); }
+        else if (c == '\n') out += "\\n";
+        else if (c == '\t') out += "\\t";
+        else if (c < 0x20) { char buf[8]; snprintf(buf, sizeof(buf), "\\u%04x", c); out += buf; }
+        else out += static_cast<char>(c);
+    }
+    return out;
+}
+
+class ErrorChannel {
+public:
+    ErrorChannel() { for (auto& c : counts) c.store(0); }
+
+    bool open_log(const char* path) {
+        log.open(path, std::ios::app);
+        return log.is_open();
+    }
+
+    void emit(const std::string& file, ExtractStatus status, const std::string& messages) {
+        counts[static_cast<size_t>(status)].fetch_add(1, std::memory_order_relaxed);
+        if (!messages.empty()) {
+            std::lock_guard<std::mutex> lock(stderr_mutex);
+            write_all(STDERR_FILENO, messages);
+        }
+        if (status != ExtractStatus::OK && status != ExtractStatus::EXCLUDED && log.is_open()) {
+            std::string text = messages;
+            while (!text.empty() && text.back() == '\n') text.pop_back();
+            std::string line = "{\"file\":\"" + json_escape(file) + "\",\"status\":\"" + extract_status_name(status)
+                             + "\",\"message\":\"" + json_escape(text) + "\"}\n";
+            std::lock_guard<std::mutex> lock(log_mutex);
+            log << line;
+        }
+    }
+
+    void flush_log() {
+        std::lock_guard<std::mutex> lock(log_mutex);
+        if (log.is_open()) log.flush();
+    }
+
+    // One line with the count of every status that occurred
+    void report_summary() const {
+        uint64_t total = 0;
+        for (const auto& c : counts) total += c.load();
+        if (!total) return;
+        std::ostringstream line;
+        line << "Info: Summary: " << total << " file(s):";
+        for (size_t i = 0; i < EXTRACT_STATUS_COUNT; ++i) {
+            if (uint64_t n = counts[i].load()) line << " " << extract_status_name(static_cast<ExtractStatus>(i)) << "=" << n;
+        }
+        line << "\n";
+        std::lock_guard<std::mutex> lock(stderr_mutex);
+        write_all(STDERR_FILENO, line.str());
+    }
+
+private:
+    std::atomic<uint64_t> counts[EXTRACT_STATUS_COUNT];
+    mutable std::mutex stderr_mutex;
+    std::mutex log_mutex;
+    std::ofstream log;
+};
+
+static ErrorChannel g_errors;
+
+// Scope for the messages of one file: everything sent to diag() in between is emitted by finish()
+class FileDiagnostics {
+public:
+    explicit FileDiagnostics(const std::string& file) : path(file), previous(t_diag) { t_diag = &buffer; t_file_size = 0; }
+    ~FileDiagnostics() { if (!finished) finish(ExtractStatus::READ_FAILED); }
+
+    ExtractStatus finish(ExtractStatus status) {
+        t_diag = previous;
+        finished = true;
+        g_errors.emit(path, status, buffer.str());
+        return status;
+    }
+
+    // Bytes in the file, from the stat done by extract_mkey (0 if it never got that far)
+    uint64_t file_size() const { return t_file_size; }
+
+private:
+    std::string path;
+    std::ostringstream buffer;
+    std::ostringstream* previous;
+    bool finished = false;
+};
 
 // --- Core Function DEFINITIONS ---
 
-// Reads all data from a Berkeley DB file into the map (Improved DB_BUFFER_SMALL handling)
-// Errors printed here go to STDERR
-bool read_all_bdb(const char* walletfile, WalletDataMap& data_map) {
+// --- BDB bulk read statistics (reported with --stats) ---
+static std::atomic<uint64_t> g_bdb_records(0);
+static std::atomic<uint64_t> g_bdb_calls(0);
+
+static void report_read_stats() {
+    uint64_t records = g_bdb_records.load(), calls = g_bdb_calls.load();
+    std::cerr << "Info: BDB reads: " << records << " record(s) in " << calls << " bulk call(s)";
+    if (calls) std::cerr << " (" << std::fixed << std::setprecision(1) << static_cast<double>(records) / calls << " records/call)";
+    std::cerr << "." << std::endl;
+}
+
+// Bulk buffer for DB_MULTIPLE_KEY reads: a multiple of 1024 and at least the largest BDB page size (64KB).
+// It only grows (doubling, or to the size BDB asks for) and is kept per thread across files.
+const size_t BDB_BULK_INITIAL_SIZE = 64 * 1024;
+const size_t BDB_BULK_MAX_SIZE = 2 * MAX_BUFFER_SIZE + 64 * 1024; // Must fit one maximal key + value
+
+// Reads all records of a Berkeley DB file and hands each one to `visit`.
+// Records are fetched a buffer-full at a time with DB_MULTIPLE_KEY instead of one c_get per record.
+// Errors printed here go to STDERR. Stopping early from the visitor still counts as success.
+bool visit_bdb_records(const char* walletfile, const RecordVisitor& visit) {
     DB* dbp = nullptr; DBC* cursor = nullptr; int ret = 0; bool success = false;
     if ((ret = db_create(&dbp, nullptr, 0)) != 0) {
          // C++ Error to STDERR
-         std::cerr << "Error: db_create failed in read_all_bdb for " << walletfile << ": " << db_strerror(ret) << std::endl;
+         diag() << "Error: db_create failed in read_all_bdb for " << walletfile << ": " << db_strerror(ret) << std::endl;
          return false;
     }
+    dbp->set_errcall(dbp, bdb_error_callback);
     if ((ret = dbp->open(dbp, nullptr, walletfile, "main", DB_BTREE, DB_RDONLY | DB_THREAD, 0)) != 0) {
          // C++ Error to STDERR
-         std::cerr << "Error: dbp->open failed in read_all_bdb for " << walletfile << ": " << db_strerror(ret) << std::endl;
+         diag() << "Error: dbp->open failed in read_all_bdb for " << walletfile << ": " << db_strerror(ret) << std::endl;
+         note_failure(ExtractStatus::OPEN_FAILED);
          if (dbp) dbp->close(dbp, 0); return false;
     }
     if ((ret = dbp->cursor(dbp, nullptr, &cursor, 0)) != 0) {
         // C++ Error to STDERR
-        std::cerr << "Error: dbp->cursor failed for " << walletfile << ": " << db_strerror(ret) << std::endl;
+        diag() << "Error: dbp->cursor failed for " << walletfile << ": " << db_strerror(ret) << std::endl;
         dbp->close(dbp, 0); return false;
     }
 
     DBT keyt = {0}, valt = {0};
-    std::vector<uint8_t> key_buf(1024);
-    std::vector<uint8_t> val_buf(4096);
+    // Reused by every file this thread reads (kept warm across files and server requests)
+    thread_local std::vector<uint8_t> key_buf(1024);
+    thread_local std::vector<uint8_t> bulk_buf(BDB_BULK_INITIAL_SIZE);
+    bool stopped = false;
 
-    while (true) { // Loop until break
+    while (!stopped) { // Loop until break
         keyt.data = key_buf.data(); keyt.ulen = key_buf.size(); keyt.flags = DB_DBT_USERMEM;
-        valt.data = val_buf.data(); valt.ulen = val_buf.size(); valt.flags = DB_DBT_USERMEM;
+        valt.data = bulk_buf.data(); valt.ulen = bulk_buf.size(); valt.flags = DB_DBT_USERMEM;
 
-        ret = cursor->c_get(cursor, &keyt, &valt, DB_NEXT); // Try to get next record
+        ret = cursor->c_get(cursor, &keyt, &valt, DB_NEXT | DB_MULTIPLE_KEY); // Next buffer-full of records
+        g_bdb_calls.fetch_add(1, std::memory_order_relaxed);
 
         if (ret == 0) {
-             try {
-                 data_map[std::vector<uint8_t>(static_cast<uint8_t*>(keyt.data), static_cast<uint8_t*>(keyt.data) + keyt.size)] =
-                     std::vector<uint8_t>(static_cast<uint8_t*>(valt.data), static_cast<uint8_t*>(valt.data) + valt.size);
-             } catch(...) { ret = -1; /* C++ Error to STDERR */ std::cerr << "Error: Memory allocation failed during map insertion for " << walletfile << std::endl; break; }
+            void* ptr = nullptr;
+            DB_MULTIPLE_INIT(ptr, &valt);
+            uint64_t batch = 0;
+            while (true) {
+                uint8_t* rkey = nullptr; uint8_t* rdata = nullptr;
+                u_int32_t rklen = 0, rdlen = 0;
+                DB_MULTIPLE_KEY_NEXT(ptr, &valt, rkey, rklen, rdata, rdlen);
+                if (ptr == nullptr) break;
+                batch++;
+                WALLET_PROBE(record, rklen, rdlen);
+                try {
+                    if (!visit(rkey, rklen, rdata, rdlen)) { stopped = true; break; }
+                } catch(...) { ret = -1; /* C++ Error to STDERR */ diag() << "Error: Memory allocation failed during map insertion for " << walletfile << std::endl; stopped = true; break; }
+            }
+            g_bdb_records.fetch_add(batch, std::memory_order_relaxed);
+            if (stopped && ret == 0) success = true;
         } else if (ret == DB_BUFFER_SMALL) {
+            // The next record alone doesn't fit: grow to what BDB asked for (at least double), cursor hasn't moved
             size_t req_key_size = keyt.size; size_t req_val_size = valt.size;
-            if (req_key_size > MAX_BUFFER_SIZE || req_val_size > MAX_BUFFER_SIZE) {
-                // C++ Warning to STDERR
-                std::cerr << "Warning: Record in " << walletfile << " exceeds MAX_BUFFER_SIZE limit. Stopping BDB read." << std::endl;
-                break;
+            size_t new_bulk = std::max(bulk_buf.size() * 2, (req_val_size + 1023) / 1024 * 1024);
+            if (req_key_size > MAX_BUFFER_SIZE || new_bulk > BDB_BULK_MAX_SIZE) {
+                if (bulk_buf.size() >= BDB_BULK_MAX_SIZE || req_val_size > BDB_BULK_MAX_SIZE || req_key_size > MAX_BUFFER_SIZE) {
+                    // C++ Warning to STDERR
+                    diag() << "Warning: Record in " << walletfile << " exceeds MAX_BUFFER_SIZE limit. Stopping BDB read." << std::endl;
+                    note_failure(ExtractStatus::TRUNCATED_RECORD);
+                    break;
+                }
+                new_bulk = BDB_BULK_MAX_SIZE;
             }
             try {
                  if (key_buf.size() < req_key_size) key_buf.resize(req_key_size + 512);
-                 if (val_buf.size() < req_val_size) val_buf.resize(req_val_size + 2048);
-            } catch (...) { ret = -1; /* C++ Error to STDERR */ std::cerr << "Error: Memory allocation failed during buffer resize for " << walletfile << std::endl; break; }
-
-            keyt.data = key_buf.data(); keyt.ulen = key_buf.size(); keyt.flags = DB_DBT_USERMEM;
-            valt.data = val_buf.data(); valt.ulen = val_buf.size(); valt.flags = DB_DBT_USERMEM;
-
-            ret = cursor->c_get(cursor, &keyt, &valt, DB_CURRENT);
-            if (ret == 0) {
-                 try {
-                     data_map[std::vector<uint8_t>(static_cast<uint8_t*>(keyt.data), static_cast<uint8_t*>(keyt.data) + keyt.size)] =
-                         std::vector<uint8_t>(static_cast<uint8_t*>(valt.data), static_cast<uint8_t*>(valt.data) + valt.size);
-                 } catch(...) { ret = -1; /* C++ Error to STDERR */ std::cerr << "Error: Memory allocation failed during map insertion (after retry) for " << walletfile << std::endl; break; }
-            } else {
-                 // C++ Warning to STDERR
-                 std::cerr << "Warning: BDB c_get retry failed after resize for " << walletfile << ": " << db_strerror(ret) << std::endl;
-                 break;
-            }
+                 bulk_buf.resize(new_bulk);
+            } catch (...) { ret = -1; /* C++ Error to STDERR */ diag() << "Error: Memory allocation failed during buffer resize for " << walletfile << std::endl; break; }
         } else if (ret == DB_NOTFOUND) {
             success = true; break;
         } else {
             // C++ Warning to STDERR
-            std::cerr << "Warning: BDB read for " << walletfile << " ended with error: " << db_strerror(ret) << std::endl;
+            diag() << "Warning: BDB read for " << walletfile << " ended with error: " << db_strerror(ret) << std::endl;
+            note_failure(ExtractStatus::TRUNCATED_RECORD);
             break;
         }
     } // End while loop
@@ -183,250 +418,2551 @@ bool read_all_bdb(const char* walletfile, WalletDataMap& data_map) {
     return success;
 }
 
-// Reads all data from the special SQLite file format into the map
-// Errors printed here go to STDERR
-bool read_all_sqlite_special(const char* walletfile, WalletDataMap& data_map) {
-    sqlite3 *db_sqlite = nullptr; sqlite3_stmt *stmt = nullptr; int rc = 0; bool success = false;
-    if ((rc = sqlite3_open_v2(walletfile, &db_sqlite, SQLITE_OPEN_READONLY, nullptr)) != SQLITE_OK) {
-        if ((rc = sqlite3_open(walletfile, &db_sqlite)) != SQLITE_OK) {
+// Percent-encodes a path for use in an SQLite "file:" URI
+static std::string sqlite_file_uri(const std::string& path) {
+    std::string uri = (!path.empty() && path[0] == '/') ? "file://" : "file:";
+    static const char* hex = "0123456789abcdef";
+    for (unsigned char c : path) {
+        if (c == '%' || c == '?' || c == '#' || c < 0x20 || c >= 0x7f) { uri += '%'; uri += hex[c >> 4]; uri += hex[c & 15]; }
+        else uri += static_cast<char>(c);
+    }
+    return uri;
+}
+
+// Opens an SQLite wallet. Normally read-only with a read-write fallback; with `immutable` (--evidence mode,
+// triage) the file is opened immutable (no locks, no journal/WAL side files, never written) with a large
+// mmap window, and a failure is final.
+static bool open_sqlite_wallet(const char* walletfile, sqlite3** db_sqlite, bool immutable) {
+    int rc = 0;
+    if (immutable) {
+        std::string uri = sqlite_file_uri(walletfile) + "?immutable=1&nolock=1";
+        if ((rc = sqlite3_open_v2(uri.c_str(), db_sqlite, SQLITE_OPEN_READONLY | SQLITE_OPEN_URI, nullptr)) != SQLITE_OK) {
+             // C++ Error to STDERR
+             diag() << "Error: SQLite failed to open file '" << walletfile << "' immutable: " << sqlite3_errmsg(*db_sqlite) << std::endl;
+             note_failure(ExtractStatus::OPEN_FAILED);
+             if(*db_sqlite) sqlite3_close(*db_sqlite);
+             *db_sqlite = nullptr;
+             return false;
+        }
+        sqlite3_exec(*db_sqlite, "PRAGMA mmap_size=" EVIDENCE_MMAP_SIZE ";", nullptr, nullptr, nullptr);
+        return true;
+    }
+    if ((rc = sqlite3_open_v2(walletfile, db_sqlite, SQLITE_OPEN_READONLY, nullptr)) != SQLITE_OK) {
+        if (*db_sqlite) { sqlite3_close(*db_sqlite); *db_sqlite = nullptr; }
+        if ((rc = sqlite3_open(walletfile, db_sqlite)) != SQLITE_OK) {
              // C++ Error to STDERR
-             std::cerr << "Error: SQLite failed to open file '" << walletfile << "': " << sqlite3_errmsg(db_sqlite) << std::endl;
-             if(db_sqlite) sqlite3_close(db_sqlite);
+             diag() << "Error: SQLite failed to open file '" << walletfile << "': " << sqlite3_errmsg(*db_sqlite) << std::endl;
+             note_failure(ExtractStatus::OPEN_FAILED);
+             if(*db_sqlite) sqlite3_close(*db_sqlite);
+             *db_sqlite = nullptr;
              return false;
         }
     }
+    return true;
+}
+
+// Reads all records of the special SQLite file format and hands each one to `visit`
+// Errors printed here go to STDERR. Stopping early from the visitor still counts as success.
+bool visit_sqlite_records(const char* walletfile, const RecordVisitor& visit) {
+    sqlite3 *db_sqlite = nullptr; sqlite3_stmt *stmt = nullptr; int rc = 0; bool success = false;
+    if (!open_sqlite_wallet(walletfile, &db_sqlite, g_evidence_mode)) return false;
     const char *sql = "SELECT key, value FROM main;";
     if ((rc = sqlite3_prepare_v2(db_sqlite, sql, -1, &stmt, nullptr)) != SQLITE_OK) {
          // C++ Error to STDERR
-         std::cerr << "Error: SQLite failed to prepare statement for " << walletfile << ": " << sqlite3_errmsg(db_sqlite) << std::endl;
+         diag() << "Error: SQLite failed to prepare statement for " << walletfile << ": " << sqlite3_errmsg(db_sqlite) << std::endl;
+         // Damaged pages vs. not a database / no 'main' table
+         note_failure(rc == SQLITE_CORRUPT ? ExtractStatus::TRUNCATED_RECORD : ExtractStatus::NOT_A_WALLET);
          sqlite3_close(db_sqlite); return false;
     }
     while ((rc = sqlite3_step(stmt)) == SQLITE_ROW) {
         const void *k_ptr = sqlite3_column_blob(stmt, 0); int k_len = sqlite3_column_bytes(stmt, 0);
         const void *v_ptr = sqlite3_column_blob(stmt, 1); int v_len = sqlite3_column_bytes(stmt, 1);
         if (k_ptr && k_len > 0 && v_ptr) {
+             WALLET_PROBE(record, k_len, v_len);
              try {
-                 data_map[std::vector<uint8_t>(static_cast<const uint8_t*>(k_ptr), static_cast<const uint8_t*>(k_ptr) + k_len)] =
-                     std::vector<uint8_t>(static_cast<const uint8_t*>(v_ptr), static_cast<const uint8_t*>(v_ptr) + v_len);
-             } catch (...) { rc = SQLITE_NOMEM; /* C++ Error to STDERR */ std::cerr << "Error: Memory allocation failed during SQLite map insertion for " << walletfile << std::endl; break; }
+                 if (!visit(static_cast<const uint8_t*>(k_ptr), k_len, static_cast<const uint8_t*>(v_ptr), v_len)) { rc = SQLITE_DONE; break; }
+             } catch (...) { rc = SQLITE_NOMEM; /* C++ Error to STDERR */ diag() << "Error: Memory allocation failed during SQLite map insertion for " << walletfile << std::endl; break; }
         }
     }
     if (rc == SQLITE_DONE) success = true;
     else if (rc != SQLITE_NOMEM) { // Don't print error again if it was memory
          // C++ Warning to STDERR
-         std::cerr << "Warning: SQLite read for " << walletfile << " ended with error code: " << rc << " (" << sqlite3_errmsg(db_sqlite) << ")" << std::endl;}
+         diag() << "Warning: SQLite read for " << walletfile << " ended with error code: " << rc << " (" << sqlite3_errmsg(db_sqlite) << ")" << std::endl;
+         note_failure(rc == SQLITE_NOTADB ? ExtractStatus::NOT_A_WALLET : ExtractStatus::TRUNCATED_RECORD);}
     sqlite3_finalize(stmt);
     sqlite3_close(db_sqlite);
     return success;
 }
 
+// Visitor that copies every record into the in-memory map
+static RecordVisitor map_inserter(WalletDataMap& data_map) {
+    return [&data_map](const uint8_t* key, size_t key_len, const uint8_t* value, size_t value_len) {
+        data_map[std::vector<uint8_t>(key, key + key_len)] = std::vector<uint8_t>(value, value + value_len);
+        return true;
+    };
+}
+
+// Reads all data from a Berkeley DB file into the map
+bool read_all_bdb(const char* walletfile, WalletDataMap& data_map) {
+    return visit_bdb_records(walletfile, map_inserter(data_map));
+}
+
+// Reads all data from the special SQLite file format into the map
+bool read_all_sqlite_special(const char* walletfile, WalletDataMap& data_map) {
+    return visit_sqlite_records(walletfile, map_inserter(data_map));
+}
+
 // Tries BDB first, then SQLite. Suppresses printing BDB error only if it's code 22.
 // BDB library itself might still print its own error to stderr.
-bool choose_and_read_all_data(const char* walletfile, WalletDataMap& data_map, DbSourceType& source_type) {
+// source_type is set before the first record is visited, so visitors may rely on it.
+bool choose_and_visit_records(const char* walletfile, const RecordVisitor& visit, DbSourceType& source_type) {
     DB* dbp_check = nullptr;
     int ret_check = 0;
     bool read_ok = false;
     source_type = DbSourceType::UNKNOWN;
+    t_failure = ExtractStatus::READ_FAILED;
 
     ret_check = db_create(&dbp_check, nullptr, 0);
     if (ret_check != 0) {
         // C++ Error to STDERR
-        std::cerr << "Error: Failed to create BDB check object for " << walletfile << ": " << db_strerror(ret_check) << std::endl;
+        diag() << "Error: Failed to create BDB check object for " << walletfile << ": " << db_strerror(ret_check) << std::endl;
         return false; // Cannot proceed
     }
+    dbp_check->set_errcall(dbp_check, bdb_error_callback);
 
-    // Attempt to open the DB file. BDB library might print format error directly to stderr here.
+    // Attempt to open the DB file. A format error reported by the BDB library goes through bdb_error_callback.
     ret_check = dbp_check->open(dbp_check, nullptr, walletfile, "main", DB_BTREE, DB_RDONLY | DB_THREAD, 0);
     int bdb_open_errno = ret_check;
     if (dbp_check) dbp_check->close(dbp_check, 0); // Clean up check handle
 
     if (bdb_open_errno == 0) { // BDB opened successfully during check
         source_type = DbSourceType::BDB;
-        read_ok = read_all_bdb(walletfile, data_map); // Use the function that prints its own errors to stderr
+        WALLET_PROBE(backend, walletfile, static_cast<int>(source_type));
+        read_ok = visit_bdb_records(walletfile, visit); // Use the function that prints its own errors to stderr
     } else { // BDB open failed during check
         // Check the specific error code returned to C++
         if (bdb_open_errno != 22) { // Use numeric code 22 for EINVAL/"Invalid argument"
             // If the error is NOT just an invalid format/argument, print a C++ warning to STDERR.
-            std::cerr << "Warning: BDB open check failed for '" << walletfile
+            diag() << "Warning: BDB open check failed for '" << walletfile
                       << "' with unexpected error: " << db_strerror(bdb_open_errno)
                       << " (Code: " << bdb_open_errno << "). Attempting SQLite fallback." << std::endl;
         }
         // Always try SQLite as fallback regardless of the BDB error code
         source_type = DbSourceType::SQLITE_SPECIAL;
-        read_ok = read_all_sqlite_special(walletfile, data_map); // Use the function that prints its own errors to stderr
+        WALLET_PROBE(backend, walletfile, static_cast<int>(source_type));
+        read_ok = visit_sqlite_records(walletfile, visit); // Use the function that prints its own errors to stderr
     }
     return read_ok;
 }
 
+bool choose_and_read_all_data(const char* walletfile, WalletDataMap& data_map, DbSourceType& source_type) {
+    return choose_and_visit_records(walletfile, map_inserter(data_map), source_type);
+}
+
+// True if the record key is the wallet's mkey (serialized "mkey" + nID; SQLite wallets use the fixed key)
+static bool is_mkey_key(const uint8_t* key, size_t key_len, DbSourceType source_type) {
+    static const uint8_t SQLITE_MKEY_PREFIX[] = {0x04, 'm', 'k', 'e', 'y'}; // Followed by a 4-byte nID
+    if (source_type == DbSourceType::SQLITE_SPECIAL) {
+        return key_len == sizeof(SQLITE_MKEY_PREFIX) + 4 && memcmp(key, SQLITE_MKEY_PREFIX, sizeof(SQLITE_MKEY_PREFIX)) == 0;
+    }
+    if (source_type == DbSourceType::BDB) {
+        try {
+            BCDataStream kds; kds.setInput(key, key_len);
+            return kds.readStringWithCompactSize() == "mkey";
+        } catch (...) { /* Ignore key parsing errors silently */ }
+    }
+    return false;
+}
+
+// Parses an mkey value (enc_key, salt, optional method + iterations). Throws SerializationError on bad data.
+static void parse_mkey_value(const uint8_t* value, size_t value_len, MKeyData& mkey_data) {
+    BCDataStream vds;
+    vds.setInput(value, value_len);
+    uint64_t enc_key_len = vds.readCompactSize();
+    if (enc_key_len > vds.size()) throw SerializationError("mkey enc_key length");
+    mkey_data.encrypted_key = vds.readBytes(static_cast<size_t>(enc_key_len));
+
+    uint64_t salt_len = vds.readCompactSize();
+    if (salt_len > vds.size()) throw SerializationError("mkey salt length");
+    mkey_data.salt = vds.readBytes(static_cast<size_t>(salt_len));
+
+    if (vds.size() >= 8) {
+        mkey_data.derivationMethod = vds.readUint32();
+        mkey_data.derivationIterations = vds.readUint32();
+    } else {
+        mkey_data.derivationMethod = 0; mkey_data.derivationIterations = 0;
+    }
+
+    if (mkey_data.salt.empty() || mkey_data.encrypted_key.empty()) {
+        throw SerializationError("Parsed mkey invalid (empty salt/key)");
+    }
+    mkey_data.found = true;
+}
+
+// Prints why no mkey was returned and records the class (invalid_mkey / no_mkey) for extract_mkey
+static ExtractStatus report_mkey_not_found(bool found_potential_mkey) {
+    if (found_potential_mkey) {
+         // C++ Error to STDERR
+         diag() << "Error: Found mkey record(s) but all failed to parse value correctly." << std::endl;
+         t_failure = ExtractStatus::INVALID_MKEY;
+    } else {
+         // C++ Error to STDERR
+         diag() << "Error: 'mkey' record not found in wallet data." << std::endl;
+         t_failure = ExtractStatus::NO_MKEY;
+    }
+    return t_failure;
+}
 
 // Finds and parses the mkey record from the data map
 // Errors printed here go to STDERR
 bool find_and_parse_mkey(const WalletDataMap& data_map, DbSourceType source_type, MKeyData& mkey_data) {
-    BCDataStream kds, vds;
-    const std::vector<uint8_t> SQLITE_MKEY_CONST_KEY = {0x04, 'm', 'k', 'e', 'y', 0x01, 0x00, 0x00, 0x00};
     bool found_potential_mkey = false;
 
     for (const auto& pair : data_map) {
         const std::vector<uint8_t>& raw_key = pair.first;
         const std::vector<uint8_t>& raw_value = pair.second;
         if (raw_key.empty() || raw_value.empty()) continue;
+        if (!is_mkey_key(raw_key.data(), raw_key.size(), source_type)) continue;
 
-        bool is_this_mkey = false;
-        if (source_type == DbSourceType::SQLITE_SPECIAL && raw_key == SQLITE_MKEY_CONST_KEY) {
-            is_this_mkey = true;
-        } else if (source_type == DbSourceType::BDB) {
-            try {
-                kds.clear(); kds.setInput(raw_key);
-                if (kds.readStringWithCompactSize() == "mkey") is_this_mkey = true;
-            } catch (...) { /* Ignore key parsing errors silently */ }
+        found_potential_mkey = true;
+        try {
+            parse_mkey_value(raw_value.data(), raw_value.size(), mkey_data);
+            return true; // Found and parsed successfully
+        } catch (const std::exception& e) {
+            // C++ Error to STDERR
+            diag() << "Error parsing potential mkey record for " << toHex(raw_key) << ": " << e.what() << std::endl;
+            mkey_data.found = false;
         }
+    } // end for loop
 
-        if (is_this_mkey) {
-             found_potential_mkey = true;
-            try {
-                vds.clear(); vds.setInput(raw_value);
-                uint64_t enc_key_len = vds.readCompactSize();
-                if (enc_key_len > vds.size()) throw SerializationError("mkey enc_key length");
-                mkey_data.encrypted_key = vds.readBytes(static_cast<size_t>(enc_key_len));
-
-                uint64_t salt_len = vds.readCompactSize();
-                if (salt_len > vds.size()) throw SerializationError("mkey salt length");
-                mkey_data.salt = vds.readBytes(static_cast<size_t>(salt_len));
-
-                if (vds.size() >= 8) {
-                    mkey_data.derivationMethod = vds.readUint32();
-                    mkey_data.derivationIterations = vds.readUint32();
-                } else {
-                    mkey_data.derivationMethod = 0; mkey_data.derivationIterations = 0;
-                }
+    report_mkey_not_found(found_potential_mkey);
+    return false;
+}
 
-                if (!mkey_data.salt.empty() && !mkey_data.encrypted_key.empty()) {
-                    mkey_data.found = true;
-                    return true; // Found and parsed successfully
-                } else {
-                    throw SerializationError("Parsed mkey invalid (empty salt/key)");
-                }
-            } catch (const std::exception& e) {
-                // C++ Error to STDERR
-                std::cerr << "Error parsing potential mkey record for " << toHex(raw_key) << ": " << e.what() << std::endl;
-                 mkey_data.found = false;
-            }
-        } // end if is_this_mkey
-    } // end for loop
+// Streaming variant for wallets that don't fit the memory budget: scans records in place and stops
+// at the first valid mkey, so only the reader's record buffers are ever held in memory.
+static ExtractStatus stream_and_parse_mkey(const char* filename, MKeyData& mkey_data) {
+    DbSourceType source_type = DbSourceType::UNKNOWN;
+    bool found_potential_mkey = false;
+    RecordVisitor visit = [&](const uint8_t* key, size_t key_len, const uint8_t* value, size_t value_len) {
+        if (key_len == 0 || value_len == 0 || !is_mkey_key(key, key_len, source_type)) return true;
+        found_potential_mkey = true;
+        try {
+            parse_mkey_value(value, value_len, mkey_data);
+            return false; // Done, stop reading
+        } catch (const std::exception& e) {
+            // C++ Error to STDERR
+            diag() << "Error parsing potential mkey record for " << toHex(std::vector<uint8_t>(key, key + key_len)) << ": " << e.what() << std::endl;
+            mkey_data.found = false;
+            return true;
+        }
+    };
+    if (!choose_and_visit_records(filename, visit, source_type)) {
+        if (source_type != DbSourceType::UNKNOWN) {
+            // C++ Error to STDERR
+            diag() << "Error: Successfully identified format but failed to read data or wallet is empty: " << filename << std::endl;
+        }
+        return t_failure;
+    }
+    if (!mkey_data.found) {
+        return report_mkey_not_found(found_potential_mkey);
+    }
+    return ExtractStatus::OK;
+}
 
-    if (found_potential_mkey && !mkey_data.found) {
-         // C++ Error to STDERR
-         std::cerr << "Error: Found mkey record(s) but all failed to parse value correctly." << std::endl;
-    } else if (!found_potential_mkey) {
-         // C++ Error to STDERR
-         std::cerr << "Error: 'mkey' record not found in wallet data." << std::endl;
+// --- Memory Budget ---
+// Workers reserve an estimate of a wallet's in-memory size before loading it. Reservations are admitted
+// strictly in arrival order, so a large wallet waits for enough memory to drain instead of being starved
+// by small ones. A wallet whose estimate exceeds the whole budget is read in streaming mode instead.
+class MemoryGovernor {
+public:
+    explicit MemoryGovernor(uint64_t budget_bytes) : budget(budget_bytes) {}
+
+    uint64_t limit() const { return budget; }
+
+    // Blocks until `bytes` fit. Returns false (nothing reserved) if they never can.
+    bool reserve(uint64_t bytes) {
+        if (bytes > budget) return false;
+        std::unique_lock<std::mutex> lock(mutex);
+        uint64_t ticket = next_ticket++;
+        bool waited = false;
+        while (ticket != serving_ticket || in_use + bytes > budget) { waited = true; cv.wait(lock); }
+        serving_ticket++;
+        in_use += bytes;
+        if (in_use > peak) peak = in_use;
+        if (waited) waits++;
+        cv.notify_all(); // The next ticket may fit as well
+        return true;
+    }
+    void release(uint64_t bytes) {
+        std::lock_guard<std::mutex> lock(mutex);
+        in_use -= bytes;
+        cv.notify_all();
     }
+    void note_streamed() { streamed++; }
 
-    return mkey_data.found;
-}
+    void report() const {
+        struct rusage usage;
+        getrusage(RUSAGE_SELF, &usage);
+        std::cerr << std::fixed << std::setprecision(1)
+                  << "Info: Memory budget " << budget / 1048576.0 << " MB: peak reserved " << peak / 1048576.0
+                  << " MB, peak RSS " << usage.ru_maxrss / 1024.0 << " MB, " << waits.load() << " file(s) waited for budget, "
+                  << streamed.load() << " file(s) streamed." << std::endl;
+    }
 
-// Extracts hash from a single file and prints ONLY the hash to STDOUT on success.
-// All other messages go to STDERR.
-void extract_and_print_hash(const char* filename) {
-    WalletDataMap data_map;
-    DbSourceType source_type = DbSourceType::UNKNOWN;
-    MKeyData mkey;
+private:
+    const uint64_t budget;
+    std::mutex mutex;
+    std::condition_variable cv;
+    uint64_t in_use = 0, peak = 0;
+    uint64_t next_ticket = 0, serving_ticket = 0;
+    std::atomic<uint64_t> waits{0}, streamed{0};
+};
 
-    // choose_and_read_all_data will print its own errors to stderr if needed
-    if (!choose_and_read_all_data(filename, data_map, source_type) || data_map.empty()) {
-        // Add a generic message here if read failed very early or map is empty after successful read attempt
-        if (data_map.empty() && source_type != DbSourceType::UNKNOWN) { // Source type known but map empty
-            // C++ Error to STDERR
-            std::cerr << "Error: Successfully identified format but failed to read data or wallet is empty: " << filename << std::endl;
-        } else if (source_type == DbSourceType::UNKNOWN && data_map.empty()) { // choose_and_read failed early (already printed its error) or map stayed empty
-             // C++ Error to STDERR (optional, as choose_and_read likely printed something)
-             // std::cerr << "Error: Failed to determine format or read data for wallet file: " << filename << std::endl;
+static MemoryGovernor* g_memory_governor = nullptr; // Set by --mem-budget
+static thread_local bool t_memory_prereserved = false; // Caller's reservation already covers this wallet (server DATA)
+
+// Map nodes plus one key and one value allocation per record roughly double the raw record bytes;
+// the constant covers reader buffers and the BDB/SQLite page caches.
+const uint64_t WALLET_MEMORY_OVERHEAD = 1024 * 1024;
+const uint64_t STREAMING_MEMORY_ESTIMATE = 2 * MAX_BUFFER_SIZE + WALLET_MEMORY_OVERHEAD;
+
+static uint64_t estimate_wallet_memory(const char* filename) {
+    struct stat st;
+    if (stat(filename, &st) != 0) return WALLET_MEMORY_OVERHEAD;
+    return 2 * static_cast<uint64_t>(st.st_size) + WALLET_MEMORY_OVERHEAD;
+}
+
+// Holds a reservation for the duration of one file. Without a governor it does nothing.
+class MemoryReservation {
+public:
+    MemoryReservation(MemoryGovernor* governor, const char* filename) : gov(t_memory_prereserved ? nullptr : governor) {
+        if (!gov) return;
+        bytes = estimate_wallet_memory(filename);
+        if (!gov->reserve(bytes)) {
+            stream = true;
+            gov->note_streamed();
+            bytes = std::min(STREAMING_MEMORY_ESTIMATE, gov->limit());
+            gov->reserve(bytes);
         }
-        return; // Stop processing this file
     }
+    ~MemoryReservation() { if (gov) gov->release(bytes); }
+    bool streaming() const { return stream; }
+
+private:
+    MemoryGovernor* gov;
+    uint64_t bytes = 0;
+    bool stream = false;
+};
+
+// Parses sizes like "512M", "4G", "65536" (binary units).
+static bool parse_size(const std::string& spec, uint64_t& bytes) {
+    char* end = nullptr;
+    unsigned long long v = strtoull(spec.c_str(), &end, 10);
+    if (end == spec.c_str()) return false;
+    uint64_t mult = 1;
+    switch (toupper(static_cast<unsigned char>(*end))) {
+        case '\0': break;
+        case 'K': mult = 1ULL << 10; break;
+        case 'M': mult = 1ULL << 20; break;
+        case 'G': mult = 1ULL << 30; break;
+        case 'T': mult = 1ULL << 40; break;
+        default: return false;
+    }
+    if (*end && end[1] != '\0' && !((end[1] == 'B' || end[1] == 'b') && end[2] == '\0')) return false;
+    bytes = static_cast<uint64_t>(v) * mult;
+    return bytes > 0;
+}
+
+// Reads a wallet file and returns its validated mkey (method 0, >= 32 byte key, non-empty salt).
+// All messages go to STDERR.
+static ExtractStatus read_and_validate_mkey(const char* filename, MKeyData& mkey) {
+    MemoryReservation reservation(g_memory_governor, filename);
+    if (reservation.streaming()) {
+        ExtractStatus status = stream_and_parse_mkey(filename, mkey);
+        if (status != ExtractStatus::OK) return status;
+    } else {
+        WalletDataMap data_map;
+        DbSourceType source_type = DbSourceType::UNKNOWN;
+
+        // choose_and_read_all_data will print its own errors to stderr if needed
+        if (!choose_and_read_all_data(filename, data_map, source_type) || data_map.empty()) {
+            // Add a generic message here if read failed very early or map is empty after successful read attempt
+            if (data_map.empty() && source_type != DbSourceType::UNKNOWN) { // Source type known but map empty
+                // C++ Error to STDERR
+                diag() << "Error: Successfully identified format but failed to read data or wallet is empty: " << filename << std::endl;
+            } else if (source_type == DbSourceType::UNKNOWN && data_map.empty()) { // choose_and_read failed early (already printed its error) or map stayed empty
+                 // C++ Error to STDERR (optional, as choose_and_read likely printed something)
+                 // diag() << "Error: Failed to determine format or read data for wallet file: " << filename << std::endl;
+            }
+            return t_failure; // Stop processing this file
+        }
 
-    // find_and_parse_mkey will print its own errors to stderr if mkey not found/parsed
-    if (!find_and_parse_mkey(data_map, source_type, mkey)) {
-        return; // Stop processing this file
+        // find_and_parse_mkey will print its own errors to stderr if mkey not found/parsed
+        if (!find_and_parse_mkey(data_map, source_type, mkey)) {
+            return t_failure; // no_mkey or invalid_mkey, set by report_mkey_not_found
+        }
     }
 
     // Check for unsupported features or invalid data, print errors to STDERR
     if (mkey.derivationMethod != 0) {
-        std::cerr << "Error: Unsupported derivation method (" << mkey.derivationMethod << ") for: " << filename << std::endl;
-        return;
+        diag() << "Error: Unsupported derivation method (" << mkey.derivationMethod << ") for: " << filename << std::endl;
+        return ExtractStatus::UNSUPPORTED_METHOD;
     }
     if (mkey.encrypted_key.size() < 32) {
-         std::cerr << "Error: Invalid mkey data (encrypted key too short < 32 bytes) for: " << filename << std::endl;
-         return;
+         diag() << "Error: Invalid mkey data (encrypted key too short < 32 bytes) for: " << filename << std::endl;
+         return ExtractStatus::INVALID_MKEY;
     }
      if (mkey.salt.empty()) {
-         std::cerr << "Error: Invalid mkey data (salt is empty) for: " << filename << std::endl;
-         return;
+         diag() << "Error: Invalid mkey data (salt is empty) for: " << filename << std::endl;
+         return ExtractStatus::INVALID_MKEY;
     }
+    return ExtractStatus::OK;
+}
 
-    // Try to generate and print the hash string ONLY to STDOUT
-    try {
-        std::vector<uint8_t> cry_master(mkey.encrypted_key.end() - 32, mkey.encrypted_key.end());
-        std::string hex_master = toHex(cry_master);
-        std::string hex_salt   = toHex(mkey.salt);
+// Entry point for one file: the open check, --exclude-hashes, and the file_start / mkey_found / file_end probes
+ExtractStatus extract_mkey(const char* filename, MKeyData& mkey) {
+    // Checked up front so a missing path never reaches SQLite (whose writable fallback would create it)
+    struct stat st;
+    if (::stat(filename, &st) != 0) {
+        diag() << "Error: Cannot open '" << filename << "': " << strerror(errno) << std::endl;
+        return ExtractStatus::OPEN_FAILED;
+    }
+    if (S_ISDIR(st.st_mode)) {
+        diag() << "Error: Cannot open '" << filename << "': Is a directory" << std::endl;
+        return ExtractStatus::OPEN_FAILED;
+    }
+    t_file_size = static_cast<uint64_t>(st.st_size);
+    WALLET_PROBE(file_start, filename, static_cast<uint64_t>(st.st_size));
+    auto started = std::chrono::steady_clock::now();
+    ExtractStatus status = read_and_validate_mkey(filename, mkey);
+    if (status == ExtractStatus::OK && is_excluded_hash(mkey)) status = ExtractStatus::EXCLUDED;
+    if (mkey.found) WALLET_PROBE(mkey_found, filename, mkey.derivationMethod, mkey.derivationIterations);
+    WALLET_PROBE(file_end, filename, extract_status_name(status),
+                 static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - started).count()),
+                 static_cast<uint64_t>(st.st_size));
+    return status;
+}
+
+// Builds the $bitcoin$ hash line (no newline) from a validated mkey.
+std::string format_hash(const MKeyData& mkey) {
+    std::vector<uint8_t> cry_master(mkey.encrypted_key.end() - 32, mkey.encrypted_key.end());
+    std::string hex_master = toHex(cry_master);
+    std::string hex_salt   = toHex(mkey.salt);
+
+    std::ostringstream oss;
+    oss << "$bitcoin$" << hex_master.size() << "$" << hex_master
+        << "$" << hex_salt.size() << "$" << hex_salt
+        << "$" << mkey.derivationIterations
+        << "$2$00$2$00";
+    return oss.str();
+}
+
+// Extracts hash from a single file and prints ONLY the hash to `out` (STDOUT or --output) on success.
+// All other messages go to STDERR. Safe to call from several workers sharing `out`.
+ExtractStatus extract_and_print_hash(const char* filename, std::ostream& out, std::mutex& out_mutex) {
+    MKeyData mkey;
+    ExtractStatus status = extract_mkey(filename, mkey);
+    if (status != ExtractStatus::OK) {
+        return status; // Stop processing this file
+    }
 
+    // Try to generate and print the hash string ONLY to the output stream
+    try {
+        std::string line = format_hash(mkey);
         // *** This is the ONLY output to STDOUT ***
-        std::cout << "$bitcoin$" << hex_master.size() << "$" << hex_master
-                  << "$" << hex_salt.size() << "$" << hex_salt
-                  << "$" << mkey.derivationIterations
-                  << "$2$00$2$00"
-                  << std::endl;
+        std::lock_guard<std::mutex> lock(out_mutex);
+        out << line << std::endl;
+        WALLET_PROBE(output_written, filename, line.size() + 1);
     } catch (const std::exception& e) {
          // C++ Error to STDERR
-         std::cerr << "Error generating hash string for " << filename << ": " << e.what() << std::endl;
+         diag() << "Error generating hash string for " << filename << ": " << e.what() << std::endl;
+         return ExtractStatus::INVALID_MKEY;
     }
+    return ExtractStatus::OK;
 }
 
-// --- main function ---
-int main(int argc, char* argv[]) {
-    // Disable buffering for stderr for immediate error output
-    setvbuf(stderr, NULL, _IONBF, 0);
+// --- Passphrase Verification ---
+// Re-derives the wallet key from owner-supplied candidates the same way Bitcoin Core does
+// (SHA-512 of passphrase||salt, then derivationIterations-1 more rounds of SHA-512 over the digest;
+// key = digest[0..31], iv = digest[32..47]) and checks the AES-256-CBC padding of the last block.
+const size_t SHA512_LANES = 4; // Candidates hashed side by side per core in the iteration loop
 
-    if (argc == 1) {
-        DIR* dp = opendir(".");
-        if (!dp) {
-            std::error_code ec(errno, std::system_category());
-            // C++ Error to STDERR
-            std::cerr << "Error opening current directory: " << ec.message() << std::endl;
-            return 1;
+static const uint64_t SHA512_K[80] = {
+    0x428a2f98d728ae22ULL, 0x7137449123ef65cdULL, 0xb5c0fbcfec4d3b2fULL, 0xe9b5dba58189dbbcULL, 0x3956c25bf348b538ULL,
+    0x59f111f1b605d019ULL, 0x923f82a4af194f9bULL, 0xab1c5ed5da6d8118ULL, 0xd807aa98a3030242ULL, 0x12835b0145706fbeULL,
+    0x243185be4ee4b28cULL, 0x550c7dc3d5ffb4e2ULL, 0x72be5d74f27b896fULL, 0x80deb1fe3b1696b1ULL, 0x9bdc06a725c71235ULL,
+    0xc19bf174cf692694ULL, 0xe49b69c19ef14ad2ULL, 0xefbe4786384f25e3ULL, 0x0fc19dc68b8cd5b5ULL, 0x240ca1cc77ac9c65ULL,
+    0x2de92c6f592b0275ULL, 0x4a7484aa6ea6e483ULL, 0x5cb0a9dcbd41fbd4ULL, 0x76f988da831153b5ULL, 0x983e5152ee66dfabULL,
+    0xa831c66d2db43210ULL, 0xb00327c898fb213fULL, 0xbf597fc7beef0ee4ULL, 0xc6e00bf33da88fc2ULL, 0xd5a79147930aa725ULL,
+    0x06ca6351e003826fULL, 0x142929670a0e6e70ULL, 0x27b70a8546d22ffcULL, 0x2e1b21385c26c926ULL, 0x4d2c6dfc5ac42aedULL,
+    0x53380d139d95b3dfULL, 0x650a73548baf63deULL, 0x766a0abb3c77b2a8ULL, 0x81c2c92e47edaee6ULL, 0x92722c851482353bULL,
+    0xa2bfe8a14cf10364ULL, 0xa81a664bbc423001ULL, 0xc24b8b70d0f89791ULL, 0xc76c51a30654be30ULL, 0xd192e819d6ef5218ULL,
+    0xd69906245565a910ULL, 0xf40e35855771202aULL, 0x106aa07032bbd1b8ULL, 0x19a4c116b8d2d0c8ULL, 0x1e376c085141ab53ULL,
+    0x2748774cdf8eeb99ULL, 0x34b0bcb5e19b48a8ULL, 0x391c0cb3c5c95a63ULL, 0x4ed8aa4ae3418acbULL, 0x5b9cca4f7763e373ULL,
+    0x682e6ff3d6b2b8a3ULL, 0x748f82ee5defb2fcULL, 0x78a5636f43172f60ULL, 0x84c87814a1f0ab72ULL, 0x8cc702081a6439ecULL,
+    0x90befffa23631e28ULL, 0xa4506cebde82bde9ULL, 0xbef9a3f7b2c67915ULL, 0xc67178f2e372532bULL, 0xca273eceea26619cULL,
+    0xd186b8c721c0c207ULL, 0xeada7dd6cde0eb1eULL, 0xf57d4f7fee6ed178ULL, 0x06f067aa72176fbaULL, 0x0a637dc5a2c898a6ULL,
+    0x113f9804bef90daeULL, 0x1b710b35131c471bULL, 0x28db77f523047d84ULL, 0x32caab7b40c72493ULL, 0x3c9ebe0a15c9bebcULL,
+    0x431d67c49c100d4cULL, 0x4cc5d4becb3e42b6ULL, 0x597f299cfc657e2aULL, 0x5fcb6fab3ad6faecULL, 0x6c44198c4a475817ULL
+};
+static const uint64_t SHA512_IV[8] = {
+    0x6a09e667f3bcc908ULL, 0xbb67ae8584caa73bULL, 0x3c6ef372fe94f82bULL, 0xa54ff53a5f1d36f1ULL,
+    0x510e527fade682d1ULL, 0x9b05688c2b3e6c1fULL, 0x1f83d9abfb41bd6bULL, 0x5be0cd19137e2179ULL
+};
+
+static inline uint64_t rotr64(uint64_t x, unsigned n) { return (x >> n) | (x << (64 - n)); }
+static inline uint64_t load_be64(const uint8_t* p) {
+    uint64_t v = 0;
+    for (int i = 0; i < 8; ++i) v = (v << 8) | p[i];
+    return v;
+}
+static inline void store_be64(uint8_t* p, uint64_t v) {
+    for (int i = 7; i >= 0; --i) { p[i] = static_cast<uint8_t>(v); v >>= 8; }
+}
+
+// Multi-buffer compression: every word holds SHA512_LANES independent messages side by side,
+// so each round is the same operation over a small array and the lanes run through the
+// pipeline (or vector registers) together instead of one dependent chain per candidate.
+static void sha512_compress_lanes(uint64_t state[8][SHA512_LANES], const uint64_t block[16][SHA512_LANES]) {
+    uint64_t w[80][SHA512_LANES];
+    for (int t = 0; t < 16; ++t)
+        for (size_t l = 0; l < SHA512_LANES; ++l) w[t][l] = block[t][l];
+    for (int t = 16; t < 80; ++t) {
+        for (size_t l = 0; l < SHA512_LANES; ++l) {
+            uint64_t s0 = rotr64(w[t-15][l], 1) ^ rotr64(w[t-15][l], 8) ^ (w[t-15][l] >> 7);
+            uint64_t s1 = rotr64(w[t-2][l], 19) ^ rotr64(w[t-2][l], 61) ^ (w[t-2][l] >> 6);
+            w[t][l] = w[t-16][l] + s0 + w[t-7][l] + s1;
+        }
+    }
+
+    uint64_t a[SHA512_LANES], b[SHA512_LANES], c[SHA512_LANES], d[SHA512_LANES];
+    uint64_t e[SHA512_LANES], f[SHA512_LANES], g[SHA512_LANES], h[SHA512_LANES];
+    for (size_t l = 0; l < SHA512_LANES; ++l) {
+        a[l] = state[0][l]; b[l] = state[1][l]; c[l] = state[2][l]; d[l] = state[3][l];
+        e[l] = state[4][l]; f[l] = state[5][l]; g[l] = state[6][l]; h[l] = state[7][l];
+    }
+    for (int t = 0; t < 80; ++t) {
+        for (size_t l = 0; l < SHA512_LANES; ++l) {
+            uint64_t S1 = rotr64(e[l], 14) ^ rotr64(e[l], 18) ^ rotr64(e[l], 41);
+            uint64_t ch = (e[l] & f[l]) ^ (~e[l] & g[l]);
+            uint64_t t1 = h[l] + S1 + ch + SHA512_K[t] + w[t][l];
+            uint64_t S0 = rotr64(a[l], 28) ^ rotr64(a[l], 34) ^ rotr64(a[l], 39);
+            uint64_t maj = (a[l] & b[l]) ^ (a[l] & c[l]) ^ (b[l] & c[l]);
+            uint64_t t2 = S0 + maj;
+            h[l] = g[l]; g[l] = f[l]; f[l] = e[l]; e[l] = d[l] + t1;
+            d[l] = c[l]; c[l] = b[l]; b[l] = a[l]; a[l] = t1 + t2;
+        }
+    }
+    for (size_t l = 0; l < SHA512_LANES; ++l) {
+        state[0][l] += a[l]; state[1][l] += b[l]; state[2][l] += c[l]; state[3][l] += d[l];
+        state[4][l] += e[l]; state[5][l] += f[l]; state[6][l] += g[l]; state[7][l] += h[l];
+    }
+}
+
+// Plain SHA-512 of an arbitrary message (used once per candidate for passphrase||salt).
+// Runs the message through lane 0 of the multi-buffer kernel.
+static void sha512(const uint8_t* data, size_t len, uint8_t out[64]) {
+    uint64_t state[8][SHA512_LANES] = {};
+    uint64_t block[16][SHA512_LANES] = {};
+    for (int i = 0; i < 8; ++i) state[i][0] = SHA512_IV[i];
+
+    std::vector<uint8_t> msg(data, data + len);
+    msg.push_back(0x80);
+    while (msg.size() % 128 != 112) msg.push_back(0);
+    for (int i = 0; i < 8; ++i) msg.push_back(0); // High 64 bits of the 128-bit length
+    uint64_t bit_len = static_cast<uint64_t>(len) * 8;
+    for (int i = 7; i >= 0; --i) msg.push_back(static_cast<uint8_t>(bit_len >> (i * 8)));
+
+    for (size_t off = 0; off < msg.size(); off += 128) {
+        for (int t = 0; t < 16; ++t) block[t][0] = load_be64(&msg[off + t * 8]);
+        sha512_compress_lanes(state, block);
+    }
+    for (int i = 0; i < 8; ++i) store_be64(out + i * 8, state[i][0]);
+}
+
+// Runs the key derivation for up to SHA512_LANES candidates at once. Every iteration after the
+// first hashes exactly one 64-byte digest, so the padded block is fixed and only words 0..7 change.
+static void derive_keys_lanes(const std::string* const* candidates, size_t count, const std::vector<uint8_t>& salt,
+                              uint32_t iterations, uint8_t out[SHA512_LANES][64]) {
+    uint64_t digest[8][SHA512_LANES] = {};
+    for (size_t l = 0; l < count; ++l) {
+        std::vector<uint8_t> buf(candidates[l]->begin(), candidates[l]->end());
+        buf.insert(buf.end(), salt.begin(), salt.end());
+        uint8_t first[64];
+        sha512(buf.data(), buf.size(), first);
+        for (int i = 0; i < 8; ++i) digest[i][l] = load_be64(first + i * 8);
+    }
+
+    uint64_t block[16][SHA512_LANES] = {};
+    for (size_t l = 0; l < SHA512_LANES; ++l) { block[8][l] = 0x8000000000000000ULL; block[15][l] = 512; }
+    for (uint32_t round = 1; round < iterations; ++round) {
+        for (int i = 0; i < 8; ++i)
+            for (size_t l = 0; l < SHA512_LANES; ++l) { block[i][l] = digest[i][l]; digest[i][l] = SHA512_IV[i]; }
+        sha512_compress_lanes(digest, block);
+    }
+    for (size_t l = 0; l < count; ++l)
+        for (int i = 0; i < 8; ++i) store_be64(out[l] + i * 8, digest[i][l]);
+}
+
+// Minimal AES-256 block decryption (only one block per candidate is ever decrypted).
+static const uint8_t AES_SBOX[256] = {
+    0x63,0x7c,0x77,0x7b,0xf2,0x6b,0x6f,0xc5,0x30,0x01,0x67,0x2b,0xfe,0xd7,0xab,0x76,0xca,0x82,0xc9,0x7d,0xfa,0x59,0x47,0xf0,0xad,0xd4,0xa2,0xaf,0x9c,0xa4,0x72,0xc0,
+    0xb7,0xfd,0x93,0x26,0x36,0x3f,0xf7,0xcc,0x34,0xa5,0xe5,0xf1,0x71,0xd8,0x31,0x15,0x04,0xc7,0x23,0xc3,0x18,0x96,0x05,0x9a,0x07,0x12,0x80,0xe2,0xeb,0x27,0xb2,0x75,
+    0x09,0x83,0x2c,0x1a,0x1b,0x6e,0x5a,0xa0,0x52,0x3b,0xd6,0xb3,0x29,0xe3,0x2f,0x84,0x53,0xd1,0x00,0xed,0x20,0xfc,0xb1,0x5b,0x6a,0xcb,0xbe,0x39,0x4a,0x4c,0x58,0xcf,
+    0xd0,0xef,0xaa,0xfb,0x43,0x4d,0x33,0x85,0x45,0xf9,0x02,0x7f,0x50,0x3c,0x9f,0xa8,0x51,0xa3,0x40,0x8f,0x92,0x9d,0x38,0xf5,0xbc,0xb6,0xda,0x21,0x10,0xff,0xf3,0xd2,
+    0xcd,0x0c,0x13,0xec,0x5f,0x97,0x44,0x17,0xc4,0xa7,0x7e,0x3d,0x64,0x5d,0x19,0x73,0x60,0x81,0x4f,0xdc,0x22,0x2a,0x90,0x88,0x46,0xee,0xb8,0x14,0xde,0x5e,0x0b,0xdb,
+    0xe0,0x32,0x3a,0x0a,0x49,0x06,0x24,0x5c,0xc2,0xd3,0xac,0x62,0x91,0x95,0xe4,0x79,0xe7,0xc8,0x37,0x6d,0x8d,0xd5,0x4e,0xa9,0x6c,0x56,0xf4,0xea,0x65,0x7a,0xae,0x08,
+    0xba,0x78,0x25,0x2e,0x1c,0xa6,0xb4,0xc6,0xe8,0xdd,0x74,0x1f,0x4b,0xbd,0x8b,0x8a,0x70,0x3e,0xb5,0x66,0x48,0x03,0xf6,0x0e,0x61,0x35,0x57,0xb9,0x86,0xc1,0x1d,0x9e,
+    0xe1,0xf8,0x98,0x11,0x69,0xd9,0x8e,0x94,0x9b,0x1e,0x87,0xe9,0xce,0x55,0x28,0xdf,0x8c,0xa1,0x89,0x0d,0xbf,0xe6,0x42,0x68,0x41,0x99,0x2d,0x0f,0xb0,0x54,0xbb,0x16
+};
+
+static inline uint8_t gf_mul(uint8_t a, uint8_t b) {
+    uint8_t p = 0;
+    while (b) {
+        if (b & 1) p ^= a;
+        a = static_cast<uint8_t>((a << 1) ^ ((a & 0x80) ? 0x1b : 0x00));
+        b >>= 1;
+    }
+    return p;
+}
+
+static void aes256_decrypt_block(const uint8_t key[32], const uint8_t in[16], uint8_t out[16]) {
+    uint8_t inv_sbox[256];
+    for (int i = 0; i < 256; ++i) inv_sbox[AES_SBOX[i]] = static_cast<uint8_t>(i);
+
+    uint8_t rk[240]; // 15 round keys
+    memcpy(rk, key, 32);
+    uint8_t rcon = 0x01;
+    for (int i = 32; i < 240; i += 4) {
+        uint8_t t[4] = { rk[i-4], rk[i-3], rk[i-2], rk[i-1] };
+        if (i % 32 == 0) {
+            uint8_t tmp = t[0];
+            t[0] = static_cast<uint8_t>(AES_SBOX[t[1]] ^ rcon); t[1] = AES_SBOX[t[2]]; t[2] = AES_SBOX[t[3]]; t[3] = AES_SBOX[tmp];
+            rcon = gf_mul(rcon, 0x02);
+        } else if (i % 32 == 16) {
+            for (int j = 0; j < 4; ++j) t[j] = AES_SBOX[t[j]];
+        }
+        for (int j = 0; j < 4; ++j) rk[i + j] = static_cast<uint8_t>(rk[i - 32 + j] ^ t[j]);
+    }
+
+    uint8_t s[16];
+    for (int i = 0; i < 16; ++i) s[i] = static_cast<uint8_t>(in[i] ^ rk[14 * 16 + i]);
+    for (int round = 13; round >= 0; --round) {
+        uint8_t tmp[16];
+        for (int c = 0; c < 4; ++c) // InvShiftRows + InvSubBytes (state is column-major)
+            for (int r = 0; r < 4; ++r) tmp[((c + r) % 4) * 4 + r] = inv_sbox[s[c * 4 + r]];
+        for (int i = 0; i < 16; ++i) s[i] = static_cast<uint8_t>(tmp[i] ^ rk[round * 16 + i]);
+        if (round == 0) break;
+        for (int c = 0; c < 4; ++c) { // InvMixColumns
+            uint8_t* col = s + c * 4;
+            uint8_t a0 = col[0], a1 = col[1], a2 = col[2], a3 = col[3];
+            col[0] = gf_mul(a0, 14) ^ gf_mul(a1, 11) ^ gf_mul(a2, 13) ^ gf_mul(a3, 9);
+            col[1] = gf_mul(a0, 9) ^ gf_mul(a1, 14) ^ gf_mul(a2, 11) ^ gf_mul(a3, 13);
+            col[2] = gf_mul(a0, 13) ^ gf_mul(a1, 9) ^ gf_mul(a2, 14) ^ gf_mul(a3, 11);
+            col[3] = gf_mul(a0, 11) ^ gf_mul(a1, 13) ^ gf_mul(a2, 9) ^ gf_mul(a3, 14);
+        }
+    }
+    memcpy(out, s, 16);
+}
+
+// The encrypted master key is 32 bytes of key material + one full PKCS#7 block, so the last
+// ciphertext block must decrypt (CBC, chained on the block before it) to sixteen 0x10 bytes.
+static bool check_mkey_padding(const MKeyData& mkey, const uint8_t derived[64]) {
+    const uint8_t* prev = mkey.encrypted_key.data() + mkey.encrypted_key.size() - 32;
+    const uint8_t* last = prev + 16;
+    uint8_t plain[16];
+    aes256_decrypt_block(derived, last, plain);
+    for (int i = 0; i < 16; ++i) {
+        if (static_cast<uint8_t>(plain[i] ^ prev[i]) != 0x10) return false;
+    }
+    return true;
+}
+
+// Runs task(i) for every i in [0, count) on up to `threads` worker threads, handing out indices dynamically.
+template <typename Fn>
+static void run_parallel(size_t count, unsigned threads, Fn task) {
+    std::atomic<size_t> next(0);
+    auto worker = [&]() {
+        for (size_t i = next.fetch_add(1); i < count; i = next.fetch_add(1)) task(i);
+    };
+    if (threads > count) threads = static_cast<unsigned>(count);
+    if (threads <= 1) { worker(); return; }
+    std::vector<std::thread> pool;
+    for (unsigned t = 0; t < threads; ++t) pool.emplace_back(worker);
+    for (auto& th : pool) th.join();
+}
+
+// Checks every passphrase in passphrase_file against every wallet. Prints "hash:passphrase" to `out`
+// (hashcat potfile style) for each match; everything else goes to STDERR.
+int verify_passphrases(const std::vector<std::string>& files, const char* passphrase_file, unsigned threads, std::ostream& out) {
+    std::ifstream in(passphrase_file, std::ios::binary);
+    if (!in) {
+        std::cerr << "Error: Cannot open passphrase file '" << passphrase_file << "'" << std::endl;
+        return 1;
+    }
+    std::vector<std::string> candidates;
+    std::string line;
+    while (std::getline(in, line)) {
+        if (!line.empty() && line.back() == '\r') line.pop_back();
+        candidates.push_back(line);
+    }
+    if (candidates.empty()) {
+        std::cerr << "Error: Passphrase file '" << passphrase_file << "' is empty" << std::endl;
+        return 1;
+    }
+
+    struct VerifyTarget {
+        std::string filename;
+        MKeyData mkey;
+        std::atomic<bool> found{false};
+        std::string passphrase;
+    };
+    std::vector<VerifyTarget> targets(files.size());
+    std::vector<size_t> usable;
+    for (size_t i = 0; i < files.size(); ++i) {
+        targets[i].filename = files[i];
+        FileDiagnostics diagnostics(files[i]);
+        if (diagnostics.finish(extract_mkey(files[i].c_str(), targets[i].mkey)) != ExtractStatus::OK) continue;
+        if (targets[i].mkey.derivationIterations == 0) {
+            std::cerr << "Error: Invalid mkey data (derivation iterations is 0) for: " << files[i] << std::endl;
+            continue;
         }
-        struct dirent* ep;
-        while ((ep = readdir(dp)) != nullptr) {
-            if (strcmp(ep->d_name, ".") == 0 || strcmp(ep->d_name, "..") == 0) continue;
-            std::string name = ep->d_name;
-            // Basic check for .dat extension (case-insensitive)
-            if (name.length() >= 4) {
-                 std::string lower_name = name;
-                 std::transform(lower_name.begin(), lower_name.end(), lower_name.begin(), ::tolower);
-                 if (lower_name.substr(lower_name.length() - 4) == ".dat")
-                 {
-                      // Process the file. Errors/Hash output handled inside.
-                      extract_and_print_hash(name.c_str());
-                 }
+        usable.push_back(i);
+    }
+
+    // One task = one wallet x one batch of SHA512_LANES candidates
+    const size_t batches = (candidates.size() + SHA512_LANES - 1) / SHA512_LANES;
+    std::mutex result_mutex;
+    run_parallel(usable.size() * batches, threads, [&](size_t task) {
+        VerifyTarget& target = targets[usable[task / batches]];
+        if (target.found.load(std::memory_order_relaxed)) return; // Already cracked, skip remaining batches
+        size_t first = (task % batches) * SHA512_LANES;
+        size_t count = std::min(SHA512_LANES, candidates.size() - first);
+
+        const std::string* lane_candidates[SHA512_LANES];
+        for (size_t l = 0; l < count; ++l) lane_candidates[l] = &candidates[first + l];
+        uint8_t derived[SHA512_LANES][64];
+        derive_keys_lanes(lane_candidates, count, target.mkey.salt, target.mkey.derivationIterations, derived);
+
+        for (size_t l = 0; l < count; ++l) {
+            if (check_mkey_padding(target.mkey, derived[l])) {
+                std::lock_guard<std::mutex> lock(result_mutex);
+                if (!target.found.load()) { target.passphrase = *lane_candidates[l]; target.found = true; }
+                return;
             }
         }
-        closedir(dp);
-    } else {
-        for (int i = 1; i < argc; ++i) {
-             // Process the file. Errors/Hash output handled inside.
-            extract_and_print_hash(argv[i]);
+    });
+
+    size_t verified = 0;
+    for (size_t idx : usable) {
+        const VerifyTarget& target = targets[idx];
+        if (target.found) {
+            out << format_hash(target.mkey) << ":" << target.passphrase << std::endl;
+            std::cerr << "Info: Passphrase verified for: " << target.filename << std::endl;
+            verified++;
+        } else {
+            std::cerr << "Info: None of the " << candidates.size() << " passphrases matched for: " << target.filename << std::endl;
         }
     }
-    return 0; // Indicate overall success (individual file errors printed to stderr)
+    std::cerr << "Info: Verified " << verified << " of " << usable.size() << " wallet(s) with " << candidates.size() << " candidate passphrase(s)." << std::endl;
+    return 0;
 }
 
-// --- Utility Function DEFINITION ---
-static std::string toHex(const std::vector<uint8_t>& data) {
-    if (data.empty()) return "";
-    std::ostringstream oss;
-    oss << std::hex << std::setfill('0');
-    for (const auto& b : data) { // Use range-based for loop
-        oss << std::setw(2) << static_cast<int>(b);
+// --- Iteration Bucketing ---
+// Cracking cost is linear in derivationIterations, so hashes are grouped into iteration ranges
+// that a scheduler can hand out separately. Default bucket upper bounds (exclusive):
+static const uint32_t DEFAULT_BUCKET_BOUNDS[] = { 50000, 100000, 250000, 500000, 1000000, 5000000 };
+
+struct IterationBucket {
+    uint32_t lo = 0, hi = 0;        // Inclusive range; hi == UINT32_MAX for the open-ended last bucket
+    std::vector<std::string> lines; // Hash lines in input order
+    uint64_t work = 0;              // Sum of iterations over all hashes in the bucket
+};
+
+// Parses a comma separated list of ascending iteration bounds ("50000,100000,..."). Returns false on bad input.
+static bool parse_bucket_bounds(const std::string& spec, std::vector<uint32_t>& bounds) {
+    bounds.clear();
+    std::stringstream ss(spec);
+    std::string item;
+    while (std::getline(ss, item, ',')) {
+        char* end = nullptr;
+        unsigned long v = strtoul(item.c_str(), &end, 10);
+        if (item.empty() || *end != '\0' || v == 0 || v > UINT32_MAX) return false;
+        if (!bounds.empty() && v <= bounds.back()) return false;
+        bounds.push_back(static_cast<uint32_t>(v));
     }
-    return oss.str();
+    return !bounds.empty();
+}
+
+// Extracts every file and writes one hash file per non-empty bucket (<prefix>.iter_<lo>-<hi>.txt)
+// plus a <prefix>.buckets.tsv summary. The summary is also printed to STDERR.
+int write_iteration_buckets(const std::vector<std::string>& files, const std::string& prefix, const std::vector<uint32_t>& bounds) {
+    std::vector<IterationBucket> buckets(bounds.size() + 1);
+    for (size_t i = 0; i < buckets.size(); ++i) {
+        buckets[i].lo = (i == 0) ? 0 : bounds[i - 1];
+        buckets[i].hi = (i < bounds.size()) ? bounds[i] - 1 : UINT32_MAX;
+    }
+
+    for (const auto& f : files) {
+        MKeyData mkey;
+        FileDiagnostics diagnostics(f);
+        if (diagnostics.finish(extract_mkey(f.c_str(), mkey)) != ExtractStatus::OK) continue;
+        size_t idx = std::upper_bound(bounds.begin(), bounds.end(), mkey.derivationIterations) - bounds.begin();
+        buckets[idx].lines.push_back(format_hash(mkey));
+        buckets[idx].work += mkey.derivationIterations;
+    }
+
+    std::string summary_path = prefix + ".buckets.tsv";
+    std::ofstream summary(summary_path);
+    if (!summary) {
+        std::cerr << "Error: Cannot create bucket summary '" << summary_path << "'" << std::endl;
+        return 1;
+    }
+    summary << "min_iterations\tmax_iterations\thashes\ttotal_work\tfile\n";
+    std::cerr << "Info: Iteration buckets (work = iterations x hashes):" << std::endl;
+
+    int rc = 0;
+    for (const auto& b : buckets) {
+        if (b.lines.empty()) continue;
+        std::string hi = (b.hi == UINT32_MAX) ? "max" : std::to_string(b.hi);
+        std::string path = prefix + ".iter_" + std::to_string(b.lo) + "-" + hi + ".txt";
+        std::ofstream out(path);
+        for (const auto& line : b.lines) out << line << '\n';
+        if (!out) {
+            std::cerr << "Error: Failed to write bucket file '" << path << "'" << std::endl;
+            rc = 1;
+        }
+        summary << b.lo << '\t' << hi << '\t' << b.lines.size() << '\t' << b.work << '\t' << path << '\n';
+        std::cerr << "  " << std::setw(8) << b.lo << " - " << std::setw(8) << hi << ": "
+                  << b.lines.size() << " hash(es), work " << b.work << " -> " << path << std::endl;
+    }
+    return rc;
+}
+
+// --- Sharding ---
+// Splits the discovered file set across nodes without coordination: a file belongs to shard K of N
+// when a stable hash (FNV-1a 64) of its relative path is K-1 modulo N. Every node that sees the same
+// file set therefore gets a disjoint slice, and the union of all slices is the full set.
+struct ShardSpec {
+    uint32_t index = 0; // 1-based K
+    uint32_t count = 0; // N, 0 = sharding disabled
+};
+
+static bool parse_shard_spec(const std::string& spec, ShardSpec& shard) {
+    size_t slash = spec.find('/');
+    if (slash == std::string::npos) return false;
+    char* end = nullptr;
+    unsigned long k = strtoul(spec.substr(0, slash).c_str(), &end, 10);
+    if (*end != '\0' || slash == 0) return false;
+    unsigned long n = strtoul(spec.substr(slash + 1).c_str(), &end, 10);
+    if (*end != '\0' || slash + 1 == spec.size()) return false;
+    if (n == 0 || k == 0 || k > n || n > UINT32_MAX) return false;
+    shard.index = static_cast<uint32_t>(k);
+    shard.count = static_cast<uint32_t>(n);
+    return true;
+}
+
+static uint64_t fnv1a64(const std::string& s) {
+    uint64_t h = 0xcbf29ce484222325ULL;
+    for (unsigned char c : s) { h ^= c; h *= 0x100000001b3ULL; }
+    return h;
+}
+
+// Keeps only the files that belong to `shard`. Each path is hashed relative to the scan root (the current
+// directory): absolute paths below it lose that prefix and a leading "./" is dropped, so nodes that mount the
+// share at different places but run from its root pick the same slices. Paths outside the root hash as given.
+static void apply_shard(std::vector<std::string>& files, const ShardSpec& shard) {
+    std::vector<std::string> kept;
+    char cwd_buf[PATH_MAX];
+    std::string root = getcwd(cwd_buf, sizeof(cwd_buf)) ? std::string(cwd_buf) : std::string();
+    if (!root.empty() && root.back() != '/') root += '/';
+    for (auto& f : files) {
+        std::string rel = f;
+        if (!root.empty() && rel.compare(0, root.size(), root) == 0) rel.erase(0, root.size());
+        while (rel.compare(0, 2, "./") == 0) rel.erase(0, 2);
+        if (fnv1a64(rel) % shard.count == shard.index - 1) kept.push_back(std::move(f));
+    }
+    files.swap(kept);
 }
+
+// Written next to a shard's output (<output>.shard) once the shard has finished, so a merge can tell
+// complete shards from ones that died half-way.
+static bool write_shard_manifest(const std::string& output, const ShardSpec& shard, size_t total_files, size_t shard_files, size_t hashes) {
+    std::string path = output + ".shard";
+    std::ofstream m(path);
+    m << "shard=" << shard.index << "/" << shard.count << "\n"
+      << "total_files=" << total_files << "\n"
+      << "files=" << shard_files << "\n"
+      << "hashes=" << hashes << "\n"
+      << "complete=1\n";
+    if (!m) {
+        std::cerr << "Error: Failed to write shard manifest '" << path << "'" << std::endl;
+        return false;
+    }
+    return true;
+}
+
+// Combines per-shard outputs into `output`, dropping duplicate lines (works for hashcat text and any
+// other line-oriented output). Refuses to write anything unless every shard 1..N reported completion.
+// Two passes keep memory at 8 bytes per line: the first collects a 64-bit hash of every line and sorts
+// them, the second writes each line, keeping the text only of lines whose hash occurs more than once
+// (so a hash collision never drops a distinct line).
+int merge_shard_outputs(const std::vector<std::string>& inputs, const std::string& output) {
+    if (inputs.empty()) {
+        std::cerr << "Error: --merge needs at least one shard output file" << std::endl;
+        return 1;
+    }
+
+    uint32_t shard_count = 0;
+    std::string total_files;
+    std::vector<int> seen;
+    bool ok = true;
+    for (const auto& in : inputs) {
+        std::ifstream m(in + ".shard");
+        if (!m) { std::cerr << "Error: No shard manifest for '" << in << "' (shard incomplete or not a shard output)" << std::endl; ok = false; continue; }
+        ShardSpec shard;
+        std::string line, files_seen;
+        bool complete = false;
+        while (std::getline(m, line)) {
+            if (line.compare(0, 6, "shard=") == 0) parse_shard_spec(line.substr(6), shard);
+            else if (line.compare(0, 12, "total_files=") == 0) files_seen = line.substr(12);
+            else if (line == "complete=1") complete = true;
+        }
+        if (shard.count == 0 || !complete) { std::cerr << "Error: Shard manifest for '" << in << "' is invalid or incomplete" << std::endl; ok = false; continue; }
+        if (shard_count == 0) { shard_count = shard.count; total_files = files_seen; seen.assign(shard_count + 1, 0); }
+        if (shard.count != shard_count) { std::cerr << "Error: '" << in << "' is shard " << shard.index << "/" << shard.count << " but other inputs use N=" << shard_count << std::endl; ok = false; continue; }
+        if (files_seen != total_files) { std::cerr << "Warning: '" << in << "' saw " << files_seen << " files before sharding, other shards saw " << total_files << std::endl; }
+        if (seen[shard.index]++) { std::cerr << "Error: Shard " << shard.index << "/" << shard_count << " given more than once" << std::endl; ok = false; }
+    }
+    for (uint32_t k = 1; ok && k <= shard_count; ++k) {
+        if (!seen[k]) { std::cerr << "Error: Shard " << k << "/" << shard_count << " is missing" << std::endl; ok = false; }
+    }
+    if (!ok) {
+        std::cerr << "Error: Not merging, shard set is incomplete." << std::endl;
+        return 1;
+    }
+
+    std::ofstream out(output);
+    if (!out) {
+        std::cerr << "Error: Cannot create merge output '" << output << "'" << std::endl;
+        return 1;
+    }
+    std::vector<uint64_t> hashes;
+    std::string line;
+    for (const auto& in : inputs) {
+        std::ifstream f(in);
+        while (std::getline(f, line))
+            if (!line.empty()) hashes.push_back(fnv1a64(line));
+    }
+    std::sort(hashes.begin(), hashes.end());
+    std::vector<uint64_t> repeated; // Hashes seen more than once, sorted
+    for (size_t i = 1; i < hashes.size(); ++i)
+        if (hashes[i] == hashes[i - 1] && (repeated.empty() || repeated.back() != hashes[i])) repeated.push_back(hashes[i]);
+    size_t total = hashes.size(), unique = 0;
+    std::vector<uint64_t>().swap(hashes);
+
+    std::unordered_set<std::string> written; // Only lines with a repeated hash
+    for (const auto& in : inputs) {
+        std::ifstream f(in);
+        while (std::getline(f, line)) {
+            if (line.empty()) continue;
+            if (std::binary_search(repeated.begin(), repeated.end(), fnv1a64(line)) && !written.insert(line).second) continue;
+            out << line << '\n';
+            unique++;
+        }
+    }
+    if (!out.flush()) {
+        std::cerr << "Error: Failed to write merge output '" << output << "'" << std::endl;
+        return 1;
+    }
+    std::cerr << "Info: Merged " << shard_count << " shard(s): " << unique << " unique line(s), "
+              << (total - unique) << " duplicate(s) dropped." << std::endl;
+    return 0;
+}
+
+// --- Binary Hashlist ---
+// Fixed-width, mmap-able alternative to the text output (--format binary). All integers little-endian.
+//   Header (64 bytes): magic "WHLBIN1\0", u32 version, u32 entry_size, u64 entry_count, u64 entries_offset,
+//                      u64 file_count, u64 index_offset, u64 strings_offset, u64 strings_size
+//   Entry (64 bytes):  ciphertext tail[32], u8 salt_len, 3 reserved, u32 method, u32 iterations,
+//                      u32 file_id, salt[16] (zero padded)
+//   Index:             u64 offset into the string table per file_id
+//   String table:      NUL-terminated source paths
+// The header is written last, so an interrupted file has no magic and is rejected by readers.
+static const char BINLIST_MAGIC[8] = {'W', 'H', 'L', 'B', 'I', 'N', '1', '\0'};
+const uint32_t BINLIST_VERSION = 1;
+const size_t BINLIST_HEADER_SIZE = 64;
+const size_t BINLIST_ENTRY_SIZE = 64;
+const size_t BINLIST_TAIL_SIZE = 32;
+const size_t BINLIST_MAX_SALT = 16;
+
+static void put_le32(uint8_t* p, uint32_t v) { for (int i = 0; i < 4; ++i) p[i] = static_cast<uint8_t>(v >> (8 * i)); }
+static void put_le64(uint8_t* p, uint64_t v) { for (int i = 0; i < 8; ++i) p[i] = static_cast<uint8_t>(v >> (8 * i)); }
+static uint32_t get_le32(const uint8_t* p) { uint32_t v = 0; for (int i = 3; i >= 0; --i) v = (v << 8) | p[i]; return v; }
+static uint64_t get_le64(const uint8_t* p) { uint64_t v = 0; for (int i = 7; i >= 0; --i) v = (v << 8) | p[i]; return v; }
+
+// Appends entries as workers finish (file_id = order of arrival). Paths are spooled to "<file>.strings.tmp"
+// so memory stays at 8 bytes per entry; finish() appends index and strings and writes the header.
+class BinaryHashlistWriter {
+public:
+    ~BinaryHashlistWriter() { if (strings) fclose(strings); }
+
+    // The string spool is unlinked as soon as it is created and only reachable through its FILE*,
+    // so a run that dies before finish() leaves nothing behind but the (headerless) output.
+    bool open(const std::string& file) {
+        path = file;
+        std::string strings_path = file + ".strings.tmp";
+        out.open(path, std::ios::binary | std::ios::trunc);
+        int fd = ::open(strings_path.c_str(), O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0600);
+        if (fd >= 0) {
+            unlink(strings_path.c_str());
+            strings = fdopen(fd, "w+b");
+            if (!strings) ::close(fd);
+        }
+        if (!out || !strings) return false;
+        char header[BINLIST_HEADER_SIZE] = {0}; // Placeholder until finish()
+        out.write(header, sizeof(header));
+        return static_cast<bool>(out);
+    }
+
+    std::ostream& stream() { return out; }
+
+    // Thread-safe. Fails (INVALID_MKEY) for salts that don't fit the fixed-width entry.
+    ExtractStatus append(const MKeyData& mkey, const std::string& source) {
+        if (mkey.salt.size() > BINLIST_MAX_SALT) {
+            // Reported through the caller's FileDiagnostics scope like the other extract failures
+            diag() << "Error: Salt of " << mkey.salt.size() << " bytes does not fit the binary hashlist (max "
+                      << BINLIST_MAX_SALT << ") for: " << source << std::endl;
+            return ExtractStatus::INVALID_MKEY;
+        }
+        uint8_t entry[BINLIST_ENTRY_SIZE] = {0};
+        memcpy(entry, mkey.encrypted_key.data() + mkey.encrypted_key.size() - BINLIST_TAIL_SIZE, BINLIST_TAIL_SIZE);
+        entry[32] = static_cast<uint8_t>(mkey.salt.size());
+        put_le32(entry + 36, mkey.derivationMethod);
+        put_le32(entry + 40, mkey.derivationIterations);
+        memcpy(entry + 48, mkey.salt.data(), mkey.salt.size());
+
+        std::lock_guard<std::mutex> lock(mutex);
+        put_le32(entry + 44, static_cast<uint32_t>(string_offsets.size()));
+        string_offsets.push_back(strings_size);
+        if (fwrite(source.c_str(), 1, source.size() + 1, strings) != source.size() + 1) spool_failed = true;
+        strings_size += source.size() + 1;
+        out.write(reinterpret_cast<const char*>(entry), sizeof(entry));
+        WALLET_PROBE(output_written, source.c_str(), BINLIST_ENTRY_SIZE);
+        return ExtractStatus::OK;
+    }
+
+    bool finish() {
+        uint64_t count = string_offsets.size();
+        uint64_t index_offset = BINLIST_HEADER_SIZE + count * BINLIST_ENTRY_SIZE;
+        uint64_t strings_offset = index_offset + count * 8;
+        uint8_t buf[8];
+        for (uint64_t off : string_offsets) { put_le64(buf, off); out.write(reinterpret_cast<const char*>(buf), 8); }
+        if (spool_failed || fflush(strings) != 0 || fseek(strings, 0, SEEK_SET) != 0) out.setstate(std::ios::failbit);
+        char chunk[64 * 1024];
+        size_t n;
+        while (out && (n = fread(chunk, 1, sizeof(chunk), strings)) > 0) out.write(chunk, n);
+        if (ferror(strings)) out.setstate(std::ios::failbit);
+        fclose(strings);
+        strings = nullptr;
+
+        uint8_t header[BINLIST_HEADER_SIZE] = {0};
+        memcpy(header, BINLIST_MAGIC, sizeof(BINLIST_MAGIC));
+        put_le32(header + 8, BINLIST_VERSION);
+        put_le32(header + 12, BINLIST_ENTRY_SIZE);
+        put_le64(header + 16, count);
+        put_le64(header + 24, BINLIST_HEADER_SIZE);
+        put_le64(header + 32, count);
+        put_le64(header + 40, index_offset);
+        put_le64(header + 48, strings_offset);
+        put_le64(header + 56, strings_size);
+        out.seekp(0);
+        out.write(reinterpret_cast<const char*>(header), sizeof(header));
+        out.close();
+        return static_cast<bool>(out);
+    }
+
+    uint64_t count() const { return string_offsets.size(); }
+
+private:
+    std::string path;
+    std::ofstream out;
+    FILE* strings = nullptr; // Unlinked spool of the source paths
+    bool spool_failed = false;
+    std::mutex mutex;
+    std::vector<uint64_t> string_offsets;
+    uint64_t strings_size = 0;
+};
+
+// Read-only mmap view of a binary hashlist. open() validates the header and all section bounds.
+class BinaryHashlistReader {
+public:
+    ~BinaryHashlistReader() { if (base) munmap(const_cast<uint8_t*>(base), length); }
+
+    static bool is_binary(const char* file) {
+        std::ifstream in(file, std::ios::binary);
+        char magic[sizeof(BINLIST_MAGIC)] = {0};
+        return in.read(magic, sizeof(magic)) && memcmp(magic, BINLIST_MAGIC, sizeof(magic)) == 0;
+    }
+
+    bool open(const char* file) {
+        int fd = ::open(file, O_RDONLY);
+        if (fd < 0) { std::cerr << "Error: Cannot open binary hashlist '" << file << "': " << strerror(errno) << std::endl; return false; }
+        struct stat st;
+        if (fstat(fd, &st) != 0 || static_cast<uint64_t>(st.st_size) < BINLIST_HEADER_SIZE) {
+            std::cerr << "Error: '" << file << "' is too small to be a binary hashlist" << std::endl;
+            ::close(fd); return false;
+        }
+        length = static_cast<size_t>(st.st_size);
+        void* p = mmap(nullptr, length, PROT_READ, MAP_SHARED, fd, 0);
+        ::close(fd);
+        if (p == MAP_FAILED) { std::cerr << "Error: mmap failed for '" << file << "': " << strerror(errno) << std::endl; return false; }
+        base = static_cast<const uint8_t*>(p);
+
+        entries = get_le64(base + 16);
+        entries_offset = get_le64(base + 24);
+        files = get_le64(base + 32);
+        index_offset = get_le64(base + 40);
+        strings_offset = get_le64(base + 48);
+        strings_size = get_le64(base + 56);
+        bool ok = memcmp(base, BINLIST_MAGIC, sizeof(BINLIST_MAGIC)) == 0 && get_le32(base + 8) == BINLIST_VERSION
+               && get_le32(base + 12) == BINLIST_ENTRY_SIZE
+               && entries <= length / BINLIST_ENTRY_SIZE && files <= length / 8
+               && entries_offset <= length && entries * BINLIST_ENTRY_SIZE <= length - entries_offset
+               && index_offset <= length && files * 8 <= length - index_offset
+               && strings_offset <= length && strings_size <= length - strings_offset;
+        if (!ok) std::cerr << "Error: '" << file << "' is not a complete binary hashlist (bad header)" << std::endl;
+        return ok;
+    }
+
+    uint64_t size() const { return entries; }
+    const uint8_t* entry(uint64_t i) const { return base + entries_offset + i * BINLIST_ENTRY_SIZE; }
+
+    // Rebuilds the fields format_hash() needs (the tail stands in for the full encrypted key)
+    void mkey(uint64_t i, MKeyData& mkey) const {
+        const uint8_t* e = entry(i);
+        size_t salt_len = std::min<size_t>(e[32], BINLIST_MAX_SALT);
+        mkey.encrypted_key.assign(e, e + BINLIST_TAIL_SIZE);
+        mkey.salt.assign(e + 48, e + 48 + salt_len);
+        mkey.derivationMethod = get_le32(e + 36);
+        mkey.derivationIterations = get_le32(e + 40);
+        mkey.found = true;
+    }
+
+    // Source path of entry i, or "" if the index/string table doesn't cover it
+    std::string source(uint64_t i) const {
+        uint32_t id = get_le32(entry(i) + 44);
+        if (id >= files) return "";
+        uint64_t off = get_le64(base + index_offset + id * 8);
+        if (off >= strings_size) return "";
+        const char* s = reinterpret_cast<const char*>(base + strings_offset + off);
+        return std::string(s, strnlen(s, strings_size - off));
+    }
+
+private:
+    const uint8_t* base = nullptr;
+    size_t length = 0;
+    uint64_t entries = 0, entries_offset = 0, files = 0, index_offset = 0, strings_offset = 0, strings_size = 0;
+};
+
+// --to-text: converts a binary hashlist back to hashcat/JtR lines
+int binary_hashlist_to_text(const char* file, std::ostream& out) {
+    BinaryHashlistReader reader;
+    if (!reader.open(file)) return 1;
+    MKeyData mkey;
+    for (uint64_t i = 0; i < reader.size(); ++i) {
+        reader.mkey(i, mkey);
+        out << format_hash(mkey) << '\n';
+    }
+    out.flush();
+    if (!out) { std::cerr << "Error: Failed to write text hashlist" << std::endl; return 1; }
+    std::cerr << "Info: Converted " << reader.size() << " hash(es) from '" << file << "'." << std::endl;
+    return 0;
+}
+
+// --- Triage ---
+// Classifies wallets from the header page plus one targeted mkey lookup, without reading the records:
+// record counts are estimates from b-tree metadata (BDB DB_FAST_STAT bt_nkeys, SQLite max(rowid)).
+const uint32_t BDB_BTREE_MAGIC = 0x053162;
+const uint32_t BDB_HASH_MAGIC = 0x061561;
+static const char SQLITE_HEADER_MAGIC[16] = "SQLite format 3"; // 16 bytes including the NUL
+const size_t TRIAGE_HEADER_BYTES = 100;
+
+struct TriageResult {
+    std::string format = "unknown";
+    std::string health = "ok";
+    bool encrypted = false;
+    uint32_t method = 0, iterations = 0;
+    int64_t records = -1; // Estimate; -1 = unknown
+    uint64_t size = 0;
+};
+
+static uint32_t get_be32(const uint8_t* p) { return (uint32_t(p[0]) << 24) | (uint32_t(p[1]) << 16) | (uint32_t(p[2]) << 8) | p[3]; }
+static uint32_t byteswap32(uint32_t v) { return (v >> 24) | ((v >> 8) & 0xff00) | ((v << 8) & 0xff0000) | (v << 24); }
+static bool valid_page_size(uint64_t n) { return n >= 512 && n <= 65536 && (n & (n - 1)) == 0; }
+
+// Size vs. the page count the header promises
+static const char* page_health(uint64_t file_size, uint64_t page_size, uint64_t pages) {
+    uint64_t expected = page_size * pages;
+    if (file_size < expected) return "truncated";
+    if (file_size > expected) return "trailing_data";
+    return "ok";
+}
+
+// The first problem found is the one reported
+static void set_health(TriageResult& r, const char* health) {
+    if (r.health == "ok") r.health = health;
+}
+
+static void triage_mkey_value(const uint8_t* value, size_t len, TriageResult& r) {
+    MKeyData mkey;
+    try {
+        parse_mkey_value(value, len, mkey);
+        r.encrypted = true;
+        r.method = mkey.derivationMethod;
+        r.iterations = mkey.derivationIterations;
+    } catch (const std::exception&) {
+        set_health(r, "bad_mkey");
+    }
+}
+
+static void triage_sqlite(const char* path, const uint8_t* header, TriageResult& r) {
+    r.format = "sqlite";
+    uint64_t page_size = (header[16] << 8) | header[17];
+    if (page_size == 1) page_size = 65536;
+    uint32_t pages = get_be32(header + 28);
+    bool pages_valid = pages != 0 && get_be32(header + 24) == get_be32(header + 92); // In-header size is trustworthy
+    if (!valid_page_size(page_size)) { set_health(r, "bad_header"); return; }
+    if (pages_valid) set_health(r, page_health(r.size, page_size, pages));
+    else if (r.size % page_size) set_health(r, "size_mismatch");
+
+    sqlite3* db = nullptr;
+    if (!open_sqlite_wallet(path, &db, true)) { set_health(r, "unreadable"); return; } // Metadata only: never write
+    // First "mkey" record whatever its nID, like triage_bdb and is_mkey_key (blob keys compare bytewise)
+    sqlite3_stmt* stmt = nullptr;
+    if (sqlite3_prepare_v2(db, "SELECT value FROM main WHERE key >= x'046d6b6579' AND key < x'046d6b657a' AND length(key) = 9 ORDER BY key LIMIT 1;",
+                           -1, &stmt, nullptr) != SQLITE_OK) {
+        set_health(r, "no_main_table");
+        sqlite3_close(db);
+        return;
+    }
+    if (sqlite3_step(stmt) == SQLITE_ROW) {
+        triage_mkey_value(static_cast<const uint8_t*>(sqlite3_column_blob(stmt, 0)), sqlite3_column_bytes(stmt, 0), r);
+    }
+    sqlite3_finalize(stmt);
+    if (sqlite3_prepare_v2(db, "SELECT max(rowid) FROM main;", -1, &stmt, nullptr) == SQLITE_OK) {
+        if (sqlite3_step(stmt) == SQLITE_ROW) r.records = sqlite3_column_int64(stmt, 0);
+        sqlite3_finalize(stmt);
+    }
+    sqlite3_close(db);
+}
+
+static void triage_bdb(const char* path, const uint8_t* header, bool swapped, TriageResult& r) {
+    r.format = "bdb";
+    uint32_t page_size = get_le32(header + 20), last_pgno = get_le32(header + 32);
+    if (swapped) { page_size = byteswap32(page_size); last_pgno = byteswap32(last_pgno); }
+    if (!valid_page_size(page_size)) { set_health(r, "bad_header"); return; }
+    set_health(r, page_health(r.size, page_size, uint64_t(last_pgno) + 1));
+
+    DB* dbp = nullptr;
+    if (db_create(&dbp, nullptr, 0) != 0) { set_health(r, "unreadable"); return; }
+    if (dbp->open(dbp, nullptr, path, "main", DB_BTREE, DB_RDONLY | DB_THREAD, 0) != 0) {
+        dbp->close(dbp, 0);
+        set_health(r, "no_main_db");
+        return;
+    }
+    // First key at or after CompactSize + "mkey", whatever its nID (the same record extract_mkey's scan takes)
+    static const uint8_t MKEY_PREFIX[] = {0x04, 'm', 'k', 'e', 'y'};
+    DBC* cursor = nullptr;
+    if (dbp->cursor(dbp, nullptr, &cursor, 0) == 0) {
+        uint8_t key_buf[sizeof(MKEY_PREFIX)];
+        memcpy(key_buf, MKEY_PREFIX, sizeof(MKEY_PREFIX));
+        DBT keyt = {0}, valt = {0};
+        keyt.data = key_buf; keyt.size = sizeof(key_buf);
+        keyt.flags = DB_DBT_MALLOC; // SET_RANGE returns the key it landed on
+        valt.flags = DB_DBT_MALLOC;
+        if (cursor->c_get(cursor, &keyt, &valt, DB_SET_RANGE) == 0) {
+            if (keyt.size >= sizeof(MKEY_PREFIX) && memcmp(keyt.data, MKEY_PREFIX, sizeof(MKEY_PREFIX)) == 0)
+                triage_mkey_value(static_cast<const uint8_t*>(valt.data), valt.size, r);
+            if (keyt.data != key_buf) free(keyt.data);
+            free(valt.data);
+        }
+        cursor->c_close(cursor);
+    }
+    // bt_nkeys is whatever count was last saved in the meta page; Bitcoin Core never refreshes it, so a
+    // 0 means unknown rather than empty and any other value is an estimate
+    DB_BTREE_STAT* stat = nullptr;
+    if (dbp->stat(dbp, nullptr, &stat, DB_FAST_STAT) == 0 && stat) {
+        if (stat->bt_nkeys > 0) r.records = stat->bt_nkeys;
+        free(stat);
+    }
+    dbp->close(dbp, 0);
+}
+
+static TriageResult triage_file(const char* path) {
+    TriageResult r;
+    int fd = ::open(path, O_RDONLY);
+    struct stat st;
+    if (fd < 0 || fstat(fd, &st) != 0) {
+        if (fd >= 0) ::close(fd);
+        set_health(r, "unreadable");
+        return r;
+    }
+    r.size = static_cast<uint64_t>(st.st_size);
+    uint8_t header[TRIAGE_HEADER_BYTES] = {0};
+    ssize_t n = pread(fd, header, sizeof(header), 0);
+    ::close(fd);
+    if (r.size == 0) { set_health(r, "empty"); return r; }
+    if (n < static_cast<ssize_t>(sizeof(header))) { set_health(r, "truncated"); return r; }
+
+    uint32_t magic = get_le32(header + 12);
+    if (memcmp(header, SQLITE_HEADER_MAGIC, sizeof(SQLITE_HEADER_MAGIC)) == 0) {
+        triage_sqlite(path, header, r);
+    } else if (magic == BDB_BTREE_MAGIC || byteswap32(magic) == BDB_BTREE_MAGIC) {
+        triage_bdb(path, header, magic != BDB_BTREE_MAGIC, r);
+    } else if (magic == BDB_HASH_MAGIC || byteswap32(magic) == BDB_HASH_MAGIC) {
+        r.format = "bdb";
+        set_health(r, "not_btree");
+    } else {
+        set_health(r, "not_a_wallet");
+    }
+    return r;
+}
+
+// --triage: one TSV line per file (path, format, encrypted, method, iterations, records, size, health)
+int triage_wallets(const std::vector<std::string>& files, unsigned threads, std::ostream& out) {
+    std::mutex out_mutex;
+    out << "#path\tformat\tencrypted\tmethod\titerations\trecords\tsize\thealth\n";
+    run_parallel(files.size(), threads, [&](size_t i) {
+        TriageResult r = triage_file(files[i].c_str());
+        std::ostringstream line;
+        line << files[i] << '\t' << r.format << '\t' << (r.encrypted ? "yes" : "no") << '\t';
+        if (r.encrypted) line << r.method << '\t' << r.iterations << '\t';
+        else line << "-\t-\t";
+        if (r.records >= 0) line << r.records; else line << '-';
+        line << '\t' << r.size << '\t' << r.health << '\n';
+        std::lock_guard<std::mutex> lock(out_mutex);
+        out << line.str();
+    });
+    out.flush();
+    return out ? 0 : 1;
+}
+
+// --- Hash Exclusion ---
+// --exclude-hashes: master keys already cracked (potfile) or queued (hashlist, text or binary) are skipped.
+// Each key is reduced to a 64-bit fingerprint of its ciphertext tail and salt, the two fields that identify it
+// in a $bitcoin$ line. The fingerprints are kept in one sorted vector: 8 bytes per entry and no false negatives.
+static inline uint64_t mix64(uint64_t x) {
+    x ^= x >> 30; x *= 0xbf58476d1ce4e5b9ULL;
+    x ^= x >> 27; x *= 0x94d049bb133111ebULL;
+    return x ^ (x >> 31);
+}
+
+// FNV-1a over tail||salt (the tail is always BINLIST_TAIL_SIZE bytes, so the boundary is unambiguous)
+static uint64_t mkey_fingerprint(const uint8_t* tail, const uint8_t* salt, size_t salt_len) {
+    uint64_t h = 0xcbf29ce484222325ULL;
+    for (size_t i = 0; i < BINLIST_TAIL_SIZE; ++i) { h ^= tail[i]; h *= 0x100000001b3ULL; }
+    for (size_t i = 0; i < salt_len; ++i) { h ^= salt[i]; h *= 0x100000001b3ULL; }
+    return mix64(h ^ salt_len);
+}
+
+static inline int hex_digit_value(char c) {
+    if (c >= '0' && c <= '9') return c - '0';
+    if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+    if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+    return -1;
+}
+
+static bool hex_to_bytes(const std::string& hex, size_t pos, size_t len, std::vector<uint8_t>& out) {
+    if (len % 2 != 0 || pos + len > hex.size()) return false;
+    out.clear();
+    for (size_t i = pos; i < pos + len; i += 2) {
+        int hi = hex_digit_value(hex[i]), lo = hex_digit_value(hex[i + 1]);
+        if (hi < 0 || lo < 0) return false;
+        out.push_back(static_cast<uint8_t>((hi << 4) | lo));
+    }
+    return true;
+}
+
+// Fingerprint of the $bitcoin$ hash in a potfile or hashlist line ("[file:]$bitcoin$64$<tail>$<n>$<salt>$...[:pass]")
+static bool bitcoin_line_fingerprint(const std::string& line, uint64_t& fingerprint) {
+    size_t start = line.find("$bitcoin$");
+    if (start == std::string::npos) return false;
+    std::vector<std::string> fields;
+    size_t pos = start + 9;
+    while (fields.size() < 4) {
+        size_t end = line.find_first_of("$:", pos);
+        fields.push_back(line.substr(pos, end == std::string::npos ? std::string::npos : end - pos));
+        if (end == std::string::npos || line[end] == ':') break;
+        pos = end + 1;
+    }
+    if (fields.size() < 4 || fields[1].size() < BINLIST_TAIL_SIZE * 2) return false;
+    std::vector<uint8_t> tail, salt;
+    if (!hex_to_bytes(fields[1], fields[1].size() - BINLIST_TAIL_SIZE * 2, BINLIST_TAIL_SIZE * 2, tail)) return false;
+    if (!hex_to_bytes(fields[3], 0, fields[3].size(), salt) || salt.empty()) return false;
+    fingerprint = mkey_fingerprint(tail.data(), salt.data(), salt.size());
+    return true;
+}
+
+class HashExclusionSet {
+public:
+    // Adds every hash in `file`: a binary hashlist (by magic) or text, one hash per line. Call finish() afterwards.
+    bool load(const char* file) {
+        size_t before = fingerprints.size(), skipped = 0;
+        if (BinaryHashlistReader::is_binary(file)) {
+            BinaryHashlistReader reader;
+            if (!reader.open(file)) return false;
+            fingerprints.reserve(fingerprints.size() + reader.size());
+            for (uint64_t i = 0; i < reader.size(); ++i) {
+                const uint8_t* e = reader.entry(i);
+                fingerprints.push_back(mkey_fingerprint(e, e + 48, std::min<size_t>(e[32], BINLIST_MAX_SALT)));
+            }
+        } else {
+            std::ifstream in(file, std::ios::binary);
+            if (!in) {
+                std::cerr << "Error: Cannot open exclusion list '" << file << "'" << std::endl;
+                return false;
+            }
+            std::string line;
+            uint64_t fingerprint = 0;
+            while (std::getline(in, line)) {
+                if (bitcoin_line_fingerprint(line, fingerprint)) fingerprints.push_back(fingerprint);
+                else if (!line.empty() && line != "\r") skipped++;
+            }
+        }
+        std::cerr << "Info: Loaded " << (fingerprints.size() - before) << " hash(es) to exclude from '" << file << "'";
+        if (skipped) std::cerr << " (" << skipped << " line(s) without a $bitcoin$ hash ignored)";
+        std::cerr << "." << std::endl;
+        return true;
+    }
+
+    void finish() {
+        std::sort(fingerprints.begin(), fingerprints.end());
+        fingerprints.erase(std::unique(fingerprints.begin(), fingerprints.end()), fingerprints.end());
+        fingerprints.shrink_to_fit();
+    }
+
+    bool contains(const MKeyData& mkey) const {
+        if (mkey.encrypted_key.size() < BINLIST_TAIL_SIZE) return false;
+        uint64_t fingerprint = mkey_fingerprint(mkey.encrypted_key.data() + mkey.encrypted_key.size() - BINLIST_TAIL_SIZE,
+                                                mkey.salt.data(), mkey.salt.size());
+        return std::binary_search(fingerprints.begin(), fingerprints.end(), fingerprint);
+    }
+
+    size_t size() const { return fingerprints.size(); }
+
+private:
+    std::vector<uint64_t> fingerprints;
+};
+
+static HashExclusionSet* g_excluded_hashes = nullptr; // Set by --exclude-hashes
+
+bool is_excluded_hash(const MKeyData& mkey) {
+    return g_excluded_hashes && g_excluded_hashes->contains(mkey);
+}
+
+// --- Checkpoint Journal ---
+// Append-only record of finished files ("<status>\t<path>" per line) so an interrupted sweep can be
+// resumed with --resume. Entries are buffered and written in batches; before a batch is written the
+// hash output is flushed, so a journaled file's hash is never lost. A crash between the two only
+// means a few files are processed again on resume (at-least-once, duplicates drop out in --merge).
+class CheckpointJournal {
+public:
+    static const size_t BATCH_SIZE = 256;
+    static const int BATCH_MAX_AGE_MS = 1000;
+
+    // `output_mutex` is the lock the workers hold while writing to `output`; the flush takes it too.
+    // `append` must match how the output was opened: a journal kept across a truncated output would make a
+    // later --resume skip files whose hashes are gone.
+    bool open(const std::string& path, std::ostream* output, std::mutex* output_mutex, bool append) {
+        file.open(path, append ? std::ios::app : std::ios::trunc);
+        out = output;
+        out_mutex = output_mutex;
+        last_flush = std::chrono::steady_clock::now();
+        return static_cast<bool>(file);
+    }
+    bool is_open() const { return file.is_open(); }
+
+    // Called by workers in completion order; the caller has already written the file's hash (if any).
+    void record(const std::string& path, ExtractStatus status) {
+        std::lock_guard<std::mutex> lock(mutex);
+        pending += extract_status_name(status);
+        pending += '\t';
+        pending += path;
+        pending += '\n';
+        auto now = std::chrono::steady_clock::now();
+        if (++pending_count >= BATCH_SIZE ||
+            std::chrono::duration_cast<std::chrono::milliseconds>(now - last_flush).count() >= BATCH_MAX_AGE_MS) {
+            flush_locked(now);
+        }
+    }
+    void flush() {
+        std::lock_guard<std::mutex> lock(mutex);
+        flush_locked(std::chrono::steady_clock::now());
+    }
+    // Flushes a batch older than BATCH_MAX_AGE_MS; for callers that idle between files (watch mode)
+    void flush_if_stale() {
+        std::lock_guard<std::mutex> lock(mutex);
+        auto now = std::chrono::steady_clock::now();
+        if (std::chrono::duration_cast<std::chrono::milliseconds>(now - last_flush).count() >= BATCH_MAX_AGE_MS) flush_locked(now);
+    }
+
+    // Reads the paths already journaled (and how many of them produced a hash). Missing file = nothing done yet.
+    static void load(const std::string& path, std::unordered_set<std::string>& done, size_t& hashes) {
+        std::ifstream in(path);
+        std::string line;
+        while (std::getline(in, line)) {
+            size_t tab = line.find('\t');
+            if (tab == std::string::npos) continue; // Torn last line from a crash
+            if (done.insert(line.substr(tab + 1)).second && line.compare(0, tab, extract_status_name(ExtractStatus::OK)) == 0) hashes++;
+        }
+    }
+
+private:
+    void flush_locked(std::chrono::steady_clock::time_point now) {
+        if (pending_count == 0) return;
+        if (out) { // Hashes first, then the journal entries that cover them
+            std::lock_guard<std::mutex> out_lock(*out_mutex); // Journal lock, then output lock; workers never nest them the other way
+            out->flush();
+        }
+        file << pending;
+        file.flush();
+        pending.clear();
+        pending_count = 0;
+        last_flush = now;
+    }
+
+    std::ofstream file;
+    std::ostream* out = nullptr;
+    std::mutex* out_mutex = nullptr;
+    std::mutex mutex;
+    std::string pending;
+    size_t pending_count = 0;
+    std::chrono::steady_clock::time_point last_flush;
+};
+
+// --- Progress Reporting ---
+// Workers only bump relaxed atomic counters once per file. A reporter thread samples them every
+// PROGRESS_INTERVAL_MS to redraw one STDERR line, and appends a JSON snapshot per second to --progress-file.
+const int PROGRESS_INTERVAL_MS = 250;
+const int PROGRESS_FILE_TICKS = 4;       // JSONL snapshot every 4 intervals (1 s)
+const int PROGRESS_LOG_TICKS = 40;       // Plain line every 10 s when STDERR is not a terminal
+
+class ProgressMeter {
+public:
+    // total == 0 means open-ended (watch mode): files are counted as they are discovered
+    explicit ProgressMeter(uint64_t total_files) : total(total_files), open_ended(total_files == 0) {
+        for (auto& c : by_status) c.store(0);
+    }
+    ~ProgressMeter() { stop(); }
+
+    bool start(const char* progress_file) {
+        if (progress_file) {
+            json.open(progress_file, std::ios::app);
+            if (!json) return false;
+        }
+        tty = isatty(STDERR_FILENO) != 0;
+        started = std::chrono::steady_clock::now();
+        reporter = std::thread([this]() { run(); });
+        return true;
+    }
+
+    void stop() {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            if (stopping || !reporter.joinable()) return;
+            stopping = true;
+        }
+        wake.notify_all();
+        reporter.join();
+    }
+
+    void file_discovered() { total.fetch_add(1, std::memory_order_relaxed); }
+    void file_done(ExtractStatus status, uint64_t file_bytes) {
+        by_status[static_cast<size_t>(status)].fetch_add(1, std::memory_order_relaxed);
+        bytes.fetch_add(file_bytes, std::memory_order_relaxed);
+        done.fetch_add(1, std::memory_order_relaxed);
+    }
+
+private:
+    struct Snapshot {
+        double elapsed = 0; uint64_t total = 0, done = 0, bytes = 0;
+        uint64_t by_status[EXTRACT_STATUS_COUNT] = {};
+        double files_per_s = 0, mb_per_s = 0, eta_s = -1;
+    };
+
+    void run() {
+        uint64_t tick = 0;
+        uint64_t last_done = 0, last_bytes = 0;
+        std::unique_lock<std::mutex> lock(mutex);
+        while (true) {
+            bool final_tick = wake.wait_for(lock, std::chrono::milliseconds(PROGRESS_INTERVAL_MS), [this]() { return stopping; });
+            ++tick;
+            Snapshot s = sample();
+            // Smoothed rates for the ETA; the first interval seeds them directly
+            double dt = PROGRESS_INTERVAL_MS / 1000.0;
+            double inst_files = (s.done - last_done) / dt, inst_bytes = (s.bytes - last_bytes) / dt;
+            last_done = s.done; last_bytes = s.bytes;
+            rate_files = tick == 1 ? inst_files : 0.8 * rate_files + 0.2 * inst_files;
+            rate_bytes = tick == 1 ? inst_bytes : 0.8 * rate_bytes + 0.2 * inst_bytes;
+            s.files_per_s = final_tick && s.elapsed > 0 ? s.done / s.elapsed : rate_files;
+            s.mb_per_s = (final_tick && s.elapsed > 0 ? s.bytes / s.elapsed : rate_bytes) / (1024.0 * 1024.0);
+            if (!open_ended && s.files_per_s > 0) s.eta_s = (s.total - std::min(s.done, s.total)) / s.files_per_s;
+
+            if (tty) std::cerr << "\r\033[K" << format_line(s) << (final_tick ? "\n" : "") << std::flush;
+            else if (final_tick || tick % PROGRESS_LOG_TICKS == 0) std::cerr << format_line(s) << std::endl;
+            if (json.is_open() && (final_tick || tick % PROGRESS_FILE_TICKS == 0)) {
+                json << format_json(s, final_tick) << '\n';
+                json.flush();
+            }
+            if (final_tick) return;
+        }
+    }
+
+    Snapshot sample() const {
+        Snapshot s;
+        s.elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - started).count();
+        s.done = done.load(std::memory_order_relaxed);
+        s.total = total.load(std::memory_order_relaxed);
+        s.bytes = bytes.load(std::memory_order_relaxed);
+        for (size_t i = 0; i < EXTRACT_STATUS_COUNT; ++i) s.by_status[i] = by_status[i].load(std::memory_order_relaxed);
+        return s;
+    }
+
+    std::string format_line(const Snapshot& s) const {
+        std::ostringstream line;
+        line << std::fixed << std::setprecision(1) << "Progress: " << s.done;
+        if (open_ended) line << " file(s) (" << s.total << " discovered)";
+        else line << "/" << s.total << " file(s) (" << (s.total ? 100.0 * s.done / s.total : 100.0) << "%)";
+        line << ", " << s.by_status[static_cast<size_t>(ExtractStatus::OK)] << " hash(es)";
+        uint64_t excluded = s.by_status[static_cast<size_t>(ExtractStatus::EXCLUDED)];
+        if (excluded) line << ", " << excluded << " excluded";
+        uint64_t failed = s.done - s.by_status[static_cast<size_t>(ExtractStatus::OK)] - excluded;
+        if (failed) {
+            line << ", " << failed << " failed [";
+            bool first = true;
+            for (size_t i = 0; i < EXTRACT_STATUS_COUNT; ++i) {
+                if (i == static_cast<size_t>(ExtractStatus::OK) || i == static_cast<size_t>(ExtractStatus::EXCLUDED) || !s.by_status[i]) continue;
+                line << (first ? "" : " ") << extract_status_name(static_cast<ExtractStatus>(i)) << "=" << s.by_status[i];
+                first = false;
+            }
+            line << "]";
+        }
+        line << ", " << s.files_per_s << " files/s, " << s.mb_per_s << " MB/s";
+        if (s.eta_s >= 0) {
+            uint64_t eta = static_cast<uint64_t>(s.eta_s + 0.5);
+            line << ", ETA " << std::setfill('0') << std::setw(2) << eta / 3600 << ":" << std::setw(2) << (eta / 60) % 60
+                 << ":" << std::setw(2) << eta % 60;
+        }
+        return line.str();
+    }
+
+    std::string format_json(const Snapshot& s, bool final_snapshot) const {
+        std::ostringstream j;
+        j << std::fixed << std::setprecision(3) << "{\"elapsed_s\":" << s.elapsed << ",\"done\":" << s.done
+          << ",\"total\":" << s.total << ",\"open_ended\":" << (open_ended ? "true" : "false")
+          << ",\"hashes\":" << s.by_status[static_cast<size_t>(ExtractStatus::OK)] << ",\"bytes\":" << s.bytes
+          << ",\"files_per_s\":" << s.files_per_s << ",\"mb_per_s\":" << s.mb_per_s;
+        if (s.eta_s >= 0) j << ",\"eta_s\":" << s.eta_s;
+        j << ",\"status\":{";
+        for (size_t i = 0; i < EXTRACT_STATUS_COUNT; ++i)
+            j << (i ? "," : "") << "\"" << extract_status_name(static_cast<ExtractStatus>(i)) << "\":" << s.by_status[i];
+        j << "},\"final\":" << (final_snapshot ? "true" : "false") << "}";
+        return j.str();
+    }
+
+    std::atomic<uint64_t> total;
+    std::atomic<uint64_t> done{0};
+    std::atomic<uint64_t> bytes{0};
+    std::atomic<uint64_t> by_status[EXTRACT_STATUS_COUNT];
+    const bool open_ended;
+    bool tty = false;
+    std::ofstream json;
+    std::chrono::steady_clock::time_point started;
+    double rate_files = 0, rate_bytes = 0;
+    std::thread reporter;
+    std::mutex mutex;
+    std::condition_variable wake;
+    bool stopping = false;
+};
+
+static ProgressMeter* g_progress = nullptr; // Set by --progress / --progress-file
+
+// --- Worker Pool ---
+// Long-lived worker threads fed from a bounded queue; submit() blocks while the queue is full, which
+// pushes back on the producer instead of letting queued work grow without limit.
+class WorkerPool {
+public:
+    WorkerPool(unsigned threads, size_t queue_limit) : limit(queue_limit ? queue_limit : 1) {
+        if (threads == 0) threads = 1;
+        for (unsigned t = 0; t < threads; ++t) workers.emplace_back([this]() { run(); });
+    }
+    ~WorkerPool() { shutdown(); }
+
+    void submit(std::function<void()> job) {
+        std::unique_lock<std::mutex> lock(mutex);
+        not_full.wait(lock, [this]() { return queue.size() < limit || stopping; });
+        queue.push_back(std::move(job));
+        not_empty.notify_one();
+    }
+
+    // Finishes all queued jobs, then joins the workers
+    void shutdown() {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            if (stopping) return;
+            stopping = true;
+        }
+        not_empty.notify_all();
+        not_full.notify_all();
+        for (auto& w : workers) w.join();
+    }
+
+private:
+    void run() {
+        while (true) {
+            std::function<void()> job;
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                not_empty.wait(lock, [this]() { return !queue.empty() || stopping; });
+                if (queue.empty()) return; // Stopping and drained
+                job = std::move(queue.front());
+                queue.pop_front();
+                not_full.notify_one();
+            }
+            job();
+        }
+    }
+
+    const size_t limit;
+    std::vector<std::thread> workers;
+    std::deque<std::function<void()>> queue;
+    std::mutex mutex;
+    std::condition_variable not_empty, not_full;
+    bool stopping = false;
+};
+
+// --- Watch Mode ---
+// Extracts wallets as they land in a drop directory. `.dat` files already there when the watch starts are
+// queued like in-place writes (they may still be growing). Files renamed into place (IN_MOVED_TO) are complete
+// and queued at once; files written in place (IN_CLOSE_WRITE) are queued after `debounce_ms` without
+// further events and only if size and mtime stayed the same, so uploads written in several passes are
+// not picked up half-way. `idle` is called at least every WATCH_IDLE_MS while waiting. Runs until SIGINT/SIGTERM.
+const int WATCH_IDLE_MS = 1000;
+static volatile sig_atomic_t g_stop_requested = 0;
+static void handle_stop_signal(int) { g_stop_requested = 1; }
+
+int watch_directory(const std::string& dir, unsigned threads, int debounce_ms, const std::function<void(const std::string&)>& process,
+                    const std::function<void()>& idle) {
+    int fd = inotify_init1(IN_CLOEXEC | IN_NONBLOCK);
+    if (fd < 0) {
+        std::error_code ec(errno, std::system_category());
+        std::cerr << "Error: inotify_init1 failed: " << ec.message() << std::endl;
+        return 1;
+    }
+    if (inotify_add_watch(fd, dir.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO) < 0) {
+        std::error_code ec(errno, std::system_category());
+        std::cerr << "Error: Cannot watch directory '" << dir << "': " << ec.message() << std::endl;
+        close(fd);
+        return 1;
+    }
+
+    struct sigaction sa;
+    memset(&sa, 0, sizeof(sa));
+    sa.sa_handler = handle_stop_signal; // No SA_RESTART: poll() must wake up on the signal
+    sigaction(SIGINT, &sa, nullptr);
+    sigaction(SIGTERM, &sa, nullptr);
+
+    struct PendingFile {
+        std::chrono::steady_clock::time_point due;
+        off_t size;
+        time_t mtime;
+    };
+    std::map<std::string, PendingFile> pending;
+    std::atomic<size_t> processed(0);
+    WorkerPool pool(threads, threads * 4);
+
+    // Scanned after the watch is in place, so a file arriving in between is seen at least once
+    std::vector<std::string> existing;
+    collect_dat_files(dir.c_str(), existing);
+    auto scanned = std::chrono::steady_clock::now();
+    for (const auto& name : existing) {
+        std::string path = dir + "/" + name;
+        struct stat st;
+        if (stat(path.c_str(), &st) != 0 || !S_ISREG(st.st_mode)) continue;
+        pending[path] = { scanned + std::chrono::milliseconds(debounce_ms), st.st_size, st.st_mtime };
+    }
+    std::cerr << "Info: Watching '" << dir << "' for new .dat files (debounce " << debounce_ms << " ms, " << pending.size()
+              << " already present). Ctrl-C to stop." << std::endl;
+
+    alignas(struct inotify_event) char buf[64 * 1024];
+    while (!g_stop_requested) {
+        auto now = std::chrono::steady_clock::now();
+        int timeout = -1;
+        for (const auto& p : pending) {
+            long long ms = std::chrono::duration_cast<std::chrono::milliseconds>(p.second.due - now).count();
+            if (ms < 0) ms = 0;
+            if (timeout < 0 || ms < timeout) timeout = static_cast<int>(ms);
+        }
+        if (timeout < 0 || timeout > WATCH_IDLE_MS) timeout = WATCH_IDLE_MS;
+
+        struct pollfd pfd = { fd, POLLIN, 0 };
+        int r = poll(&pfd, 1, timeout);
+        if (r < 0 && errno != EINTR) {
+            std::error_code ec(errno, std::system_category());
+            std::cerr << "Error: poll on inotify failed: " << ec.message() << std::endl;
+            break;
+        }
+
+        ssize_t len;
+        while (r > 0 && (len = read(fd, buf, sizeof(buf))) > 0) {
+            now = std::chrono::steady_clock::now();
+            for (char* p = buf; p < buf + len; ) {
+                const struct inotify_event* ev = reinterpret_cast<const struct inotify_event*>(p);
+                p += sizeof(struct inotify_event) + ev->len;
+                if (ev->mask & IN_Q_OVERFLOW) {
+                    std::cerr << "Warning: inotify queue overflowed, some arrivals in '" << dir << "' may have been missed." << std::endl;
+                    continue;
+                }
+                if (ev->len == 0 || (ev->mask & IN_ISDIR) || !has_dat_extension(ev->name)) continue;
+
+                std::string path = dir + "/" + ev->name;
+                struct stat st;
+                if (stat(path.c_str(), &st) != 0) continue; // Gone again
+                bool complete = (ev->mask & IN_MOVED_TO) != 0;
+                pending[path] = { complete ? now : now + std::chrono::milliseconds(debounce_ms), st.st_size, st.st_mtime };
+            }
+        }
+
+        now = std::chrono::steady_clock::now();
+        for (auto it = pending.begin(); it != pending.end(); ) {
+            if (it->second.due > now) { ++it; continue; }
+            struct stat st;
+            if (stat(it->first.c_str(), &st) != 0) { it = pending.erase(it); continue; }
+            if (st.st_size != it->second.size || st.st_mtime != it->second.mtime) {
+                // Still being written: wait another quiet period
+                it->second = { now + std::chrono::milliseconds(debounce_ms), st.st_size, st.st_mtime };
+                ++it;
+                continue;
+            }
+            std::string path = it->first;
+            it = pending.erase(it);
+            if (g_progress) g_progress->file_discovered();
+            pool.submit([path, &process, &processed]() { process(path); processed++; });
+        }
+        if (idle) idle();
+    }
+
+    pool.shutdown();
+    close(fd);
+    std::cerr << "Info: Watch stopped, " << processed.load() << " file(s) processed." << std::endl;
+    return 0;
+}
+
+// --- Server Mode ---
+// Long-running extraction service on a Unix domain socket. Line protocol, requests may be pipelined
+// and responses come back in completion order, so clients match them by <id> (any token without spaces):
+//   PATH <id> <path>\n            extract from a file the server can read
+//   DATA <id> <length>\n<bytes>   extract from a wallet sent inline (<length> raw bytes follow)
+// Responses, <latency_us> measured from request receipt to response:
+//   OK <id> <latency_us> <hash>\n
+//   ERR <id> <latency_us> <status>\n    status as in the journal (read_failed, no_mkey, ...), bad_request, or
+//                                       over_budget (DATA that can never fit --mem-budget)
+// Worker threads and reader buffers stay warm between requests. With --mem-budget, a DATA request reserves
+// its payload, the temp copy and the parse estimate before the bytes are read, so readers wait for budget
+// instead of buffering. At most SERVER_MAX_CONNECTIONS clients are served at once; others wait in the backlog.
+const size_t SERVER_MAX_DATA_BYTES = 256 * 1024 * 1024;
+const size_t SERVER_MAX_CONNECTIONS = 64;
+
+// Budget for one DATA request: the payload and its copy in /dev/shm, plus the parse estimate of the wallet
+static uint64_t estimate_request_memory(uint64_t length) {
+    return 2 * length + (2 * length + WALLET_MEMORY_OVERHEAD);
+}
+
+class ServerConnection {
+public:
+    explicit ServerConnection(int socket_fd) : fd(socket_fd) {}
+    ~ServerConnection() { close(fd); }
+
+    // Whole-line writes under a lock so responses from different workers never interleave
+    void send_line(const std::string& line) {
+        std::lock_guard<std::mutex> lock(write_mutex);
+        size_t off = 0;
+        while (off < line.size()) {
+            ssize_t n = send(fd, line.data() + off, line.size() - off, MSG_NOSIGNAL);
+            if (n < 0 && errno == EINTR) continue;
+            if (n <= 0) return; // Client went away; drop the response
+            off += static_cast<size_t>(n);
+        }
+    }
+
+    bool read_line(std::string& line) {
+        while (true) {
+            size_t nl = buffer.find('\n');
+            if (nl != std::string::npos) {
+                line.assign(buffer, 0, nl);
+                buffer.erase(0, nl + 1);
+                if (!line.empty() && line.back() == '\r') line.pop_back();
+                return true;
+            }
+            if (buffer.size() > 64 * 1024 || !fill()) return false; // Oversized line or EOF
+        }
+    }
+    bool read_bytes(size_t n, std::string& out) {
+        while (buffer.size() < n) {
+            if (!fill()) return false;
+        }
+        out.assign(buffer, 0, n);
+        buffer.erase(0, n);
+        return true;
+    }
+    // Drops `n` payload bytes without keeping them, so the connection stays in sync after a rejection
+    bool skip_bytes(size_t n) {
+        while (n > 0) {
+            if (buffer.empty() && !fill()) return false;
+            size_t k = std::min(n, buffer.size());
+            buffer.erase(0, k);
+            n -= k;
+        }
+        return true;
+    }
+
+    const int fd;
+
+private:
+    bool fill() {
+        char chunk[64 * 1024];
+        while (true) {
+            ssize_t n = recv(fd, chunk, sizeof(chunk), 0);
+            if (n < 0 && errno == EINTR) { if (g_stop_requested) return false; continue; }
+            if (n <= 0) return false;
+            buffer.append(chunk, static_cast<size_t>(n));
+            return true;
+        }
+    }
+
+    std::string buffer;
+    std::mutex write_mutex;
+};
+
+// Wallet libraries need a path (SQLite resolves /proc/self/fd links, so memfd won't do); inline wallets
+// go to a short-lived file in /dev/shm (RAM backed) or $TMPDIR that is removed right after extraction.
+static ExtractStatus extract_mkey_from_buffer(const std::string& data, MKeyData& mkey) {
+    struct stat st;
+    const char* tmpdir = getenv("TMPDIR");
+    std::string dir = (stat("/dev/shm", &st) == 0 && S_ISDIR(st.st_mode)) ? "/dev/shm" : (tmpdir ? tmpdir : "/tmp");
+    std::string path = dir + "/wallet-request-XXXXXX";
+    int tfd = mkstemp(&path[0]);
+    if (tfd < 0) {
+        std::error_code ec(errno, std::system_category());
+        diag() << "Error: Cannot create temporary file in " << dir << ": " << ec.message() << std::endl;
+        return ExtractStatus::READ_FAILED;
+    }
+    size_t off = 0;
+    bool written = true;
+    while (off < data.size()) {
+        ssize_t n = write(tfd, data.data() + off, data.size() - off);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) {
+            std::error_code ec(n < 0 ? errno : ENOSPC, std::system_category());
+            diag() << "Error: Cannot write temporary file '" << path << "': " << ec.message() << std::endl;
+            written = false;
+            break;
+        }
+        off += static_cast<size_t>(n);
+    }
+    close(tfd);
+    ExtractStatus status = written ? extract_mkey(path.c_str(), mkey) : ExtractStatus::READ_FAILED;
+    unlink(path.c_str());
+    return status;
+}
+
+static void serve_connection(std::shared_ptr<ServerConnection> conn, WorkerPool& pool, std::atomic<size_t>& served) {
+    std::string line;
+    while (!g_stop_requested && conn->read_line(line)) {
+        if (line.empty()) continue;
+        auto received = std::chrono::steady_clock::now();
+        std::istringstream req(line);
+        std::string verb, id;
+        req >> verb >> id;
+
+        std::shared_ptr<std::string> payload = std::make_shared<std::string>();
+        bool inline_data = false;
+        uint64_t reserved = 0;
+        if (verb == "PATH" && !id.empty()) {
+            std::getline(req >> std::ws, *payload);
+        } else if (verb == "DATA" && !id.empty()) {
+            unsigned long long length = 0;
+            if (!(req >> length) || length > SERVER_MAX_DATA_BYTES) {
+                conn->send_line("ERR " + id + " 0 bad_request\n");
+                return; // Can't resynchronise without a valid length
+            }
+            if (g_memory_governor) {
+                reserved = estimate_request_memory(length);
+                if (!g_memory_governor->reserve(reserved)) { // Larger than the whole budget
+                    if (!conn->skip_bytes(static_cast<size_t>(length))) return;
+                    conn->send_line("ERR " + id + " 0 over_budget\n");
+                    continue;
+                }
+            }
+            if (!conn->read_bytes(static_cast<size_t>(length), *payload)) {
+                if (reserved) g_memory_governor->release(reserved);
+                return;
+            }
+            inline_data = true;
+        }
+        if (payload->empty()) {
+            if (reserved) g_memory_governor->release(reserved);
+            conn->send_line("ERR " + (id.empty() ? std::string("-") : id) + " 0 bad_request\n");
+            continue;
+        }
+
+        pool.submit([conn, id, payload, inline_data, reserved, received, &served]() {
+            MKeyData mkey;
+            FileDiagnostics diagnostics(inline_data ? "DATA " + id : *payload);
+            t_memory_prereserved = reserved != 0;
+            ExtractStatus status = diagnostics.finish(inline_data ? extract_mkey_from_buffer(*payload, mkey) : extract_mkey(payload->c_str(), mkey));
+            t_memory_prereserved = false;
+            if (reserved) {
+                std::string().swap(*payload);
+                g_memory_governor->release(reserved);
+            }
+            long long latency_us = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - received).count();
+            std::ostringstream resp;
+            if (status == ExtractStatus::OK) resp << "OK " << id << " " << latency_us << " " << format_hash(mkey) << "\n";
+            else resp << "ERR " << id << " " << latency_us << " " << extract_status_name(status) << "\n";
+            conn->send_line(resp.str());
+            served++;
+        });
+    }
+}
+
+int serve_unix_socket(const std::string& socket_path, unsigned threads) {
+    struct sockaddr_un addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    if (socket_path.size() >= sizeof(addr.sun_path)) {
+        std::cerr << "Error: Socket path too long: " << socket_path << std::endl;
+        return 1;
+    }
+    strncpy(addr.sun_path, socket_path.c_str(), sizeof(addr.sun_path) - 1);
+
+    int listen_fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    struct stat st;
+    if (stat(socket_path.c_str(), &st) == 0 && S_ISSOCK(st.st_mode)) unlink(socket_path.c_str()); // Stale socket from a previous run
+    if (listen_fd < 0 || bind(listen_fd, reinterpret_cast<struct sockaddr*>(&addr), sizeof(addr)) != 0 || listen(listen_fd, 64) != 0) {
+        std::error_code ec(errno, std::system_category());
+        std::cerr << "Error: Cannot listen on '" << socket_path << "': " << ec.message() << std::endl;
+        if (listen_fd >= 0) close(listen_fd);
+        return 1;
+    }
+
+    struct sigaction sa;
+    memset(&sa, 0, sizeof(sa));
+    sa.sa_handler = handle_stop_signal; // No SA_RESTART: poll()/recv() must wake up on the signal
+    sigaction(SIGINT, &sa, nullptr);
+    sigaction(SIGTERM, &sa, nullptr);
+
+    std::atomic<size_t> served(0);
+    WorkerPool pool(threads, threads * 4);
+    struct ClientReader {
+        std::thread thread;
+        std::weak_ptr<ServerConnection> conn;
+        std::shared_ptr<std::atomic<bool>> done;
+    };
+    std::vector<ClientReader> readers;
+    std::cerr << "Info: Serving on '" << socket_path << "' with " << threads << " worker(s). Ctrl-C to stop." << std::endl;
+
+    while (!g_stop_requested) {
+        // Reap readers of clients that have disconnected
+        for (auto it = readers.begin(); it != readers.end(); ) {
+            if (*it->done) { it->thread.join(); it = readers.erase(it); } else ++it;
+        }
+
+        // At the connection cap, leave new clients in the listen backlog until a reader is reaped
+        struct pollfd pfd = { listen_fd, readers.size() < SERVER_MAX_CONNECTIONS ? static_cast<short>(POLLIN) : static_cast<short>(0), 0 };
+        int r = poll(&pfd, 1, readers.size() < SERVER_MAX_CONNECTIONS ? 500 : 50);
+        if (r <= 0 || !(pfd.revents & POLLIN)) continue;
+        int client = accept4(listen_fd, nullptr, nullptr, SOCK_CLOEXEC);
+        if (client < 0) continue;
+        std::shared_ptr<ServerConnection> conn = std::make_shared<ServerConnection>(client);
+        std::shared_ptr<std::atomic<bool>> done = std::make_shared<std::atomic<bool>>(false);
+        std::thread reader([conn, done, &pool, &served]() { serve_connection(conn, pool, served); *done = true; });
+        readers.push_back({ std::move(reader), conn, done });
+    }
+
+    close(listen_fd);
+    unlink(socket_path.c_str());
+    for (auto& r : readers) {
+        // Wake readers blocked in recv(); queued responses can still be written
+        if (auto conn = r.conn.lock()) ::shutdown(conn->fd, SHUT_RD);
+        r.thread.join();
+    }
+    pool.shutdown();
+    std::cerr << "Info: Server stopped, " << served.load() << " request(s) served." << std::endl;
+    return 0;
+}
+
+// --- Disk-Order Scheduling ---
+// On rotational media (and HDD images mounted loopback) reading files in readdir order costs a seek per
+// file. --disk-order sorts the work list by where each file starts on the device, and workers ask the
+// kernel to read ahead the next few files (posix_fadvise WILLNEED) while the current ones are parsed.
+struct DiskPosition {
+    uint64_t device = 0;
+    bool by_extent = false; // Sorted by physical offset; otherwise by inode number (FIEMAP unsupported)
+    uint64_t position = 0;
+};
+
+// Physical byte offset of the file's first extent, if the filesystem reports a real one
+static bool first_extent_offset(int fd, uint64_t& physical) {
+    union {
+        struct fiemap map;
+        uint8_t raw[sizeof(struct fiemap) + sizeof(struct fiemap_extent)];
+    } buf;
+    memset(&buf, 0, sizeof(buf));
+    buf.map.fm_start = 0;
+    buf.map.fm_length = FIEMAP_MAX_OFFSET;
+    buf.map.fm_extent_count = 1;
+    if (ioctl(fd, FS_IOC_FIEMAP, &buf.map) != 0 || buf.map.fm_mapped_extents == 0) return false;
+    const struct fiemap_extent& extent = buf.map.fm_extents[0];
+    if (extent.fe_flags & (FIEMAP_EXTENT_UNKNOWN | FIEMAP_EXTENT_DATA_INLINE | FIEMAP_EXTENT_NOT_ALIGNED)) return false;
+    physical = extent.fe_physical;
+    return true;
+}
+
+static DiskPosition disk_position(const std::string& path) {
+    DiskPosition pos;
+    int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) return pos; // Unreadable files sort first and fail fast
+    struct stat st;
+    if (fstat(fd, &st) == 0) {
+        pos.device = st.st_dev;
+        pos.position = st.st_ino;
+        uint64_t physical = 0;
+        if (first_extent_offset(fd, physical)) { pos.by_extent = true; pos.position = physical; }
+    }
+    ::close(fd);
+    return pos;
+}
+
+// Reorders `files` by device, then physical offset (files without one follow, by inode)
+static void sort_by_disk_order(std::vector<std::string>& files, unsigned threads) {
+    std::vector<DiskPosition> positions(files.size());
+    run_parallel(files.size(), threads, [&](size_t i) { positions[i] = disk_position(files[i]); });
+    std::vector<size_t> order(files.size());
+    for (size_t i = 0; i < order.size(); ++i) order[i] = i;
+    std::sort(order.begin(), order.end(), [&](size_t a, size_t b) {
+        const DiskPosition& pa = positions[a];
+        const DiskPosition& pb = positions[b];
+        if (pa.device != pb.device) return pa.device < pb.device;
+        if (pa.by_extent != pb.by_extent) return pa.by_extent;
+        if (pa.position != pb.position) return pa.position < pb.position;
+        return files[a] < files[b];
+    });
+    size_t by_extent = 0;
+    std::vector<std::string> sorted;
+    sorted.reserve(files.size());
+    for (size_t i : order) {
+        sorted.push_back(std::move(files[i]));
+        if (positions[i].by_extent) by_extent++;
+    }
+    files.swap(sorted);
+    std::cerr << "Info: Disk order: " << files.size() << " file(s) sorted, " << by_extent << " by physical extent, "
+              << (files.size() - by_extent) << " by inode." << std::endl;
+}
+
+// Keeps WILLNEED advice `window` files ahead of the highest file claimed so far. Safe to call from workers.
+class ReadaheadWindow {
+public:
+    ReadaheadWindow(const std::vector<std::string>& files, size_t window) : files(files), window(window) {}
+
+    void claimed(size_t index) {
+        if (window == 0) return;
+        size_t target = std::min(files.size(), index + 1 + window);
+        size_t from = advised.load();
+        while (from < target && !advised.compare_exchange_weak(from, target)) {}
+        for (size_t i = from; i < target; ++i) advise(files[i]); // Only the thread that moved the mark gets here with from < target
+    }
+
+private:
+    static void advise(const std::string& path) {
+        int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+        if (fd < 0) return;
+        posix_fadvise(fd, 0, 0, POSIX_FADV_WILLNEED); // Starts async reads into the page cache the reader will hit
+        ::close(fd);
+    }
+
+    const std::vector<std::string>& files;
+    const size_t window;
+    std::atomic<size_t> advised{0};
+};
+
+// --- Usage ---
+static void print_usage(const char* prog) {
+    std::cerr << "Usage: " << prog << " [options] [wallet_file1.dat ...]\n"
+              << "With no wallet files, all .dat files in the current directory are processed.\n"
+              << "Options:\n"
+              << "  --verify-passphrases <file>  Check the passphrases in <file> (one per line) against each wallet\n"
+              << "  --triage                     Classify each file from its header and mkey lookup only: one TSV line with\n"
+              << "                               format, encrypted, method, iterations, approx. records, size and health\n"
+              << "  --bucket-iterations <prefix> Group hashes by iteration range into <prefix>.iter_<lo>-<hi>.txt files\n"
+              << "                               and write a per-bucket count/work summary to <prefix>.buckets.tsv\n"
+              << "  --bucket-bounds <n,n,...>    Ascending bucket upper bounds (default: 50000,100000,250000,500000,1000000,5000000)\n"
+              << "  -o, --output <file>          Write hashes to <file> instead of STDOUT\n"
+              << "  --format <text|binary>       Output format; binary is a fixed-width, mmap-able hashlist with a\n"
+              << "                               source path per entry (requires -o, not with --journal/--resume/--shard/--watch)\n"
+              << "  --to-text <file>             Convert a binary hashlist to hashcat/JtR text (STDOUT or -o)\n"
+              << "  --shard <K/N>                Only process shard K of N (stable hash of the path relative to the current\n"
+              << "                               directory; run every node from the root of the same file set);\n"
+              << "                               with -o, <file>.shard records the shard once it has completed\n"
+              << "  --merge <out> <in>...        Merge per-shard outputs into <out> with duplicates removed,\n"
+              << "                               after checking that every shard 1..N completed\n"
+              << "  --journal <file>             Record each finished file and its status in <file> (checkpoint; started\n"
+              << "                               afresh unless --resume or --watch, like the -o output)\n"
+              << "  --resume                     Skip files already in the journal and append to the existing output\n"
+              << "  --mem-budget <size>          Limit memory held by loaded wallets (e.g. 2G); files wait for budget,\n"
+              << "                               wallets larger than the whole budget are scanned in streaming mode\n"
+              << "  --watch <dir>                Extract the .dat files in <dir>, then keep extracting new ones as\n"
+              << "                               they arrive (inotify)\n"
+              << "  --debounce-ms <n>            Quiet period before a file written in place is picked up (default: 100)\n"
+              << "  --serve <socket>             Run as a service on a Unix socket (PATH/DATA requests, see README)\n"
+              << "  --evidence                   Evidence-safe reads: SQLite wallets are opened immutable with no locking\n"
+              << "                               and mmap, and never reopened read-write\n"
+              << "  --progress                   Show a live progress line on STDERR (files, hashes, failures, rates, ETA)\n"
+              << "  --progress-file <file>       Append a JSON progress snapshot to <file> every second (implies --progress)\n"
+              << "  --error-log <file>           Append one JSON line per failed file (file, status, messages) to <file>\n"
+              << "  --exclude-hashes <file>      Skip wallets whose hash is in <file> (hashcat/JtR potfile, text or binary\n"
+              << "                               hashlist; repeatable). Counted as 'excluded' in the summary\n"
+              << "  --stats                      Print read statistics (BDB records per bulk call) at the end\n"
+              << "  --disk-order                 Process files in on-disk order (FIEMAP physical offset, else inode) with\n"
+              << "                               readahead of the next files; for spinning disks and HDD images\n"
+              << "  --readahead <n>              Files to read ahead with --disk-order (default: 2 per thread, 0 = off)\n"
+              << "  -j, --threads <n>            Worker threads (default: number of CPUs)\n"
+              << "  -h, --help                   Show this help\n";
+}
+
+// Basic check for .dat extension (case-insensitive)
+static bool has_dat_extension(const std::string& name) {
+    if (name.length() < 4) return false;
+    std::string lower_name = name.substr(name.length() - 4);
+    std::transform(lower_name.begin(), lower_name.end(), lower_name.begin(), ::tolower);
+    return lower_name == ".dat";
+}
+
+// Collects .dat files (case-insensitive) from a directory. Returns false if the directory can't be opened.
+static bool collect_dat_files(const char* dir, std::vector<std::string>& files) {
+    DIR* dp = opendir(dir);
+    if (!dp) {
+        std::error_code ec(errno, std::system_category());
+        // C++ Error to STDERR
+        std::cerr << "Error opening current directory: " << ec.message() << std::endl;
+        return false;
+    }
+    struct dirent* ep;
+    while ((ep = readdir(dp)) != nullptr) {
+        if (strcmp(ep->d_name, ".") == 0 || strcmp(ep->d_name, "..") == 0) continue;
+        if (has_dat_extension(ep->d_name)) files.push_back(ep->d_name);
+    }
+    closedir(dp);
+    return true;
+}
+
+#ifndef WALLET_NO_MAIN
+// --- main function ---
+int main(int argc, char* argv[]) {
+    std::vector<std::string> files;
+    const char* passphrase_file = nullptr;
+    const char* bucket_prefix = nullptr;
+    std::vector<uint32_t> bucket_bounds(std::begin(DEFAULT_BUCKET_BOUNDS), std::end(DEFAULT_BUCKET_BOUNDS));
+    const char* output_file = nullptr;
+    const char* merge_output = nullptr;
+    ShardSpec shard;
+    const char* journal_file = nullptr;
+    bool resume = false;
+    uint64_t mem_budget = 0;
+    const char* watch_dir = nullptr;
+    int debounce_ms = 100;
+    const char* serve_socket = nullptr;
+    bool stats = false;
+    bool binary_format = false;
+    bool triage = false;
+    const char* error_log = nullptr;
+    const char* to_text = nullptr;
+    bool progress = false;
+    const char* progress_file = nullptr;
+    bool disk_order = false;
+    std::vector<const char*> exclude_files;
+    int readahead = -1;
+    unsigned threads = std::thread::hardware_concurrency();
+    if (threads == 0) threads = 1;
+
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg == "-h" || arg == "--help") {
+            print_usage(argv[0]);
+            return 0;
+        } else if (arg == "--verify-passphrases" && i + 1 < argc) {
+            passphrase_file = argv[++i];
+        } else if (arg == "--triage") {
+            triage = true;
+        } else if (arg == "--bucket-iterations" && i + 1 < argc) {
+            bucket_prefix = argv[++i];
+        } else if (arg == "--bucket-bounds" && i + 1 < argc) {
+            if (!parse_bucket_bounds(argv[++i], bucket_bounds)) {
+                std::cerr << "Error: Invalid --bucket-bounds '" << argv[i] << "' (expected ascending numbers, e.g. 50000,100000)" << std::endl;
+                return 1;
+            }
+        } else if ((arg == "-o" || arg == "--output") && i + 1 < argc) {
+            output_file = argv[++i];
+        } else if (arg == "--shard" && i + 1 < argc) {
+            if (!parse_shard_spec(argv[++i], shard)) {
+                std::cerr << "Error: Invalid --shard '" << argv[i] << "' (expected K/N with 1 <= K <= N)" << std::endl;
+                return 1;
+            }
+        } else if (arg == "--merge" && i + 1 < argc) {
+            merge_output = argv[++i];
+        } else if (arg == "--journal" && i + 1 < argc) {
+            journal_file = argv[++i];
+        } else if (arg == "--resume") {
+            resume = true;
+        } else if (arg == "--mem-budget" && i + 1 < argc) {
+            if (!parse_size(argv[++i], mem_budget)) {
+                std::cerr << "Error: Invalid --mem-budget '" << argv[i] << "' (expected e.g. 512M or 4G)" << std::endl;
+                return 1;
+            }
+        } else if (arg == "--watch" && i + 1 < argc) {
+            watch_dir = argv[++i];
+        } else if (arg == "--debounce-ms" && i + 1 < argc) {
+            debounce_ms = std::max(0, atoi(argv[++i]));
+        } else if (arg == "--serve" && i + 1 < argc) {
+            serve_socket = argv[++i];
+        } else if (arg == "--evidence") {
+            g_evidence_mode = true;
+        } else if (arg == "--progress") {
+            progress = true;
+        } else if (arg == "--progress-file" && i + 1 < argc) {
+            progress_file = argv[++i];
+            progress = true;
+        } else if (arg == "--format" && i + 1 < argc) {
+            std::string format = argv[++i];
+            if (format != "text" && format != "binary") {
+                std::cerr << "Error: Invalid --format '" << format << "' (expected text or binary)" << std::endl;
+                return 1;
+            }
+            binary_format = format == "binary";
+        } else if (arg == "--to-text" && i + 1 < argc) {
+            to_text = argv[++i];
+        } else if (arg == "--error-log" && i + 1 < argc) {
+            error_log = argv[++i];
+        } else if (arg == "--stats") {
+            stats = true;
+        } else if (arg == "--exclude-hashes" && i + 1 < argc) {
+            exclude_files.push_back(argv[++i]);
+        } else if (arg == "--disk-order") {
+            disk_order = true;
+        } else if (arg == "--readahead" && i + 1 < argc) {
+            readahead = std::max(0, atoi(argv[++i]));
+        } else if ((arg == "-j" || arg == "--threads") && i + 1 < argc) {
+            int n = atoi(argv[++i]);
+            threads = n > 0 ? static_cast<unsigned>(n) : 1;
+        } else if (arg.size() > 1 && arg[0] == '-') {
+            std::cerr << "Error: Unknown or incomplete option '" << arg << "'" << std::endl;
+            print_usage(argv[0]);
+            return 1;
+        } else {
+            files.push_back(arg);
+        }
+    }
+
+    if (merge_output) {
+        return merge_shard_outputs(files, merge_output);
+    }
+    if (to_text) {
+        if (!output_file) return binary_hashlist_to_text(to_text, std::cout);
+        std::ofstream text(output_file, std::ios::trunc);
+        if (!text) {
+            std::cerr << "Error: Cannot create output file '" << output_file << "'" << std::endl;
+            return 1;
+        }
+        return binary_hashlist_to_text(to_text, text);
+    }
+    if (binary_format && (!output_file || resume || journal_file || shard.count || watch_dir || passphrase_file || bucket_prefix || triage)) {
+        std::cerr << "Error: --format binary requires -o <file> and only applies to hash extraction (not --resume, --journal, --shard, --watch," << std::endl;
+        std::cerr << "       --verify-passphrases, --bucket-iterations or --triage)" << std::endl;
+        return 1;
+    }
+
+    if (disk_order && (watch_dir || serve_socket)) {
+        std::cerr << "Error: --disk-order only applies to a fixed list of files (not --watch or --serve)" << std::endl;
+        return 1;
+    }
+    if (watch_dir && (passphrase_file || bucket_prefix || triage)) {
+        std::cerr << "Error: --watch only extracts hashes (not with --verify-passphrases, --bucket-iterations or --triage)" << std::endl;
+        return 1;
+    }
+
+    if (error_log && !g_errors.open_log(error_log)) {
+        std::cerr << "Error: Cannot open error log '" << error_log << "'" << std::endl;
+        return 1;
+    }
+
+    HashExclusionSet excluded_hashes;
+    if (!exclude_files.empty()) {
+        for (const char* f : exclude_files)
+            if (!excluded_hashes.load(f)) return 1;
+        excluded_hashes.finish();
+        g_excluded_hashes = &excluded_hashes;
+    }
+
+    std::unique_ptr<MemoryGovernor> governor;
+    if (mem_budget) {
+        governor.reset(new MemoryGovernor(mem_budget));
+        g_memory_governor = governor.get();
+    }
+    if (serve_socket) {
+        int rc = serve_unix_socket(serve_socket, threads);
+        if (governor) governor->report();
+        if (stats) report_read_stats();
+        return rc;
+    }
+
+    if (files.empty() && !watch_dir) {
+        if (!collect_dat_files(".", files)) return 1;
+    }
+    size_t discovered = files.size();
+    if (shard.count) {
+        apply_shard(files, shard);
+        std::cerr << "Info: Shard " << shard.index << "/" << shard.count << ": " << files.size() << " of " << discovered << " file(s)." << std::endl;
+    }
+    size_t shard_files = files.size();
+
+    if (resume && !journal_file) {
+        std::cerr << "Error: --resume requires --journal <file>" << std::endl;
+        return 1;
+    }
+    size_t resumed_hashes = 0;
+    if (resume) {
+        std::unordered_set<std::string> done;
+        CheckpointJournal::load(journal_file, done, resumed_hashes);
+        size_t before = files.size();
+        files.erase(std::remove_if(files.begin(), files.end(), [&](const std::string& f) { return done.count(f) != 0; }), files.end());
+        std::cerr << "Info: Resuming: " << (before - files.size()) << " file(s) already journaled, " << files.size() << " remaining." << std::endl;
+    }
+    if (disk_order) sort_by_disk_order(files, threads);
+
+    std::ofstream out_file;
+    BinaryHashlistWriter binary_out;
+    if (binary_format) {
+        if (!binary_out.open(output_file)) {
+            std::cerr << "Error: Cannot create output file '" << output_file << "'" << std::endl;
+            return 1;
+        }
+    } else if (output_file) {
+        out_file.open(output_file, (resume || watch_dir) ? std::ios::app : std::ios::trunc);
+        if (!out_file) {
+            std::cerr << "Error: Cannot create output file '" << output_file << "'" << std::endl;
+            return 1;
+        }
+    }
+    std::ostream& out = binary_format ? binary_out.stream() : output_file ? static_cast<std::ostream&>(out_file) : std::cout;
+
+    if (passphrase_file) {
+        return verify_passphrases(files, passphrase_file, threads, out);
+    }
+    if (bucket_prefix) {
+        return write_iteration_buckets(files, bucket_prefix, bucket_bounds);
+    }
+    if (triage) {
+        return triage_wallets(files, threads, out);
+    }
+
+    std::mutex out_mutex;
+    CheckpointJournal journal;
+    if (journal_file && !journal.open(journal_file, &out, &out_mutex, resume || watch_dir)) {
+        std::cerr << "Error: Cannot open journal file '" << journal_file << "'" << std::endl;
+        return 1;
+    }
+
+    std::unique_ptr<ProgressMeter> meter;
+    if (progress) {
+        meter.reset(new ProgressMeter(watch_dir ? 0 : files.size()));
+        if (!meter->start(progress_file)) {
+            std::cerr << "Error: Cannot open progress file '" << progress_file << "'" << std::endl;
+            return 1;
+        }
+        g_progress = meter.get();
+    }
+
+    std::atomic<size_t> hashes(resumed_hashes);
+    auto process_file = [&](const std::string& path) {
+        // Process the file. Hash output handled inside; its messages are emitted as one block by finish().
+        FileDiagnostics diagnostics(path);
+        ExtractStatus status;
+        if (binary_format) {
+            MKeyData mkey;
+            status = extract_mkey(path.c_str(), mkey);
+            if (status == ExtractStatus::OK) status = binary_out.append(mkey, path);
+        } else {
+            status = extract_and_print_hash(path.c_str(), out, out_mutex);
+        }
+        diagnostics.finish(status);
+        if (status == ExtractStatus::OK) hashes++;
+        if (g_progress) g_progress->file_done(status, diagnostics.file_size());
+        if (journal.is_open()) journal.record(path, status);
+    };
+
+    if (watch_dir) {
+        int rc = watch_directory(watch_dir, threads, debounce_ms, process_file, [&]() {
+            if (journal.is_open()) journal.flush_if_stale();
+        });
+        if (meter) meter->stop();
+        if (journal.is_open()) journal.flush();
+        g_errors.flush_log();
+        g_errors.report_summary();
+        if (governor) governor->report();
+        if (stats) report_read_stats();
+        return rc;
+    }
+
+    // Files are independent; workers pick them up dynamically and finish in any order.
+    // With --disk-order they are claimed in disk order, so reads sweep across the device.
+    ReadaheadWindow readahead_window(files, disk_order ? (readahead < 0 ? 2 * threads : static_cast<size_t>(readahead)) : 0);
+    run_parallel(files.size(), threads, [&](size_t i) {
+        readahead_window.claimed(i);
+        process_file(files[i]);
+    });
+    if (meter) meter->stop();
+    if (journal.is_open()) journal.flush();
+    g_errors.flush_log();
+    g_errors.report_summary();
+    if (governor) governor->report();
+    if (stats) report_read_stats();
+
+    if (output_file) {
+        bool written = binary_format ? binary_out.finish() : (out_file.close(), static_cast<bool>(out_file));
+        if (!written) {
+            std::cerr << "Error: Failed to write output file '" << output_file << "'" << std::endl;
+            return 1;
+        }
+        if (shard.count && !write_shard_manifest(output_file, shard, discovered, shard_files, hashes)) return 1;
+    }
+    return 0; // Indicate overall success (individual file errors printed to stderr)
+}
+
+#endif // WALLET_NO_MAIN
+
+// --- Utility Function DEFINITION ---
+static std::string toHex(const std::vector<uint8_t>& data) {
+    if (data.empty()) return "";
+    std::ostringstream oss;
+    oss << std::hex << std::setfill('0');
+    for (const auto& b : data) { // Use range-based for loop
+        oss << std::setw(2) << static_cast<int>(b);
+    }
+    return oss.str();
+}
+
+#ifdef WALLET_NAMESPACE
+} // namespace WALLET_NAMESPACE
+#endif
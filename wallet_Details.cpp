@@ -18,10 +18,56 @@
 #include <set>       // Not used in current code, but kept from original
 #include <cstdio>    // For sprintf in alternative toHex
 #include <system_error> // For opendir error reporting
+#include <chrono>    // For probe durations
+#include <fstream>
+#include <thread>
+#include <atomic>
+#include <mutex>
+#include <queue>
+#include <memory>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+// --- Static Tracepoints ---
+// USDT probes (provider "wallet_details"), compiled out when <sys/sdt.h> is unavailable; see probes/*.bt
+#if defined(__has_include)
+#if __has_include(<sys/sdt.h>)
+#include <sys/sdt.h>
+#define DETAILS_PROBE(name, ...) STAP_PROBEV(wallet_details, name, ##__VA_ARGS__)
+#endif
+#endif
+#ifndef DETAILS_PROBE
+template <typename... Args> static inline void details_probe_args(const Args&...) {}
+#define DETAILS_PROBE(name, ...) do { if (false) details_probe_args(__VA_ARGS__); } while (0)
+#endif
+
+// wallet_bench.cpp builds this file together with the other program: WALLET_NAMESPACE keeps the two sets of
+// definitions apart and WALLET_NO_MAIN drops main(). Headers are included above, outside the namespace.
+#ifdef WALLET_NAMESPACE
+namespace WALLET_NAMESPACE {
+#endif
 
 // --- Constants and Error Class ---
 const size_t INITIAL_BUFFER_SIZE = 4 * 1024;
 const size_t MAX_BUFFER_SIZE = 4 * 1024 * 4096; // Limit record size
+#define EVIDENCE_MMAP_SIZE "268435456" // 256MB SQLite mmap window in --evidence mode (same value as wallet.cpp)
+
+// --evidence: open SQLite wallets immutable/lock-free and never fall back to a writable open
+static bool g_evidence_mode = false;
+
+// Output levels: 2 = everything (default), 1 = --quiet (no Info lines). Index workers set t_silent so
+// per-file reader/parser messages from parallel threads are dropped; they report failures themselves.
+static int g_verbosity = 2;
+static thread_local bool t_silent = false;
+
+static std::ostream& null_out() {
+    thread_local std::ostream sink(nullptr); // Per thread: writes to a stream without a buffer still set its state
+    return sink;
+}
+static std::ostream& info_out() { return (t_silent || g_verbosity < 2) ? null_out() : std::cout; }
+static std::ostream& warn_out() { return t_silent ? null_out() : std::cerr; }
 
 class SerializationError : public std::runtime_error {
 public:
@@ -184,6 +230,18 @@ static std::string toHex_sprintf(const std::vector<uint8_t>& data) {
 }
 
 
+// Percent-encodes a path for use in an SQLite "file:" URI. Copy of the helper in wallet.cpp (each tool is one
+// translation unit); keep the two in sync.
+static std::string sqlite_file_uri(const std::string& path) {
+    std::string uri = (!path.empty() && path[0] == '/') ? "file://" : "file:";
+    static const char* hex = "0123456789abcdef";
+    for (unsigned char c : path) {
+        if (c == '%' || c == '?' || c == '#' || c < 0x20 || c >= 0x7f) { uri += '%'; uri += hex[c >> 4]; uri += hex[c & 15]; }
+        else uri += static_cast<char>(c);
+    }
+    return uri;
+}
+
 // BDB db_cursor_get (needed for read_all_bdb)
 int db_cursor_get(DBC* cursor, DBT* keyt, DBT* valt, uint32_t flags,
                   std::vector<uint8_t>& key_buf, std::vector<uint8_t>& val_buf) {
@@ -195,7 +253,7 @@ int db_cursor_get(DBC* cursor, DBT* keyt, DBT* valt, uint32_t flags,
 
     if (ret == DB_BUFFER_SMALL) {
         if (keyt->size > MAX_BUFFER_SIZE || valt->size > MAX_BUFFER_SIZE) {
-            std::cerr << "Error: BDB record size exceeds MAX_BUFFER_SIZE limit. Key req: " << keyt->size << ", Val req: " << valt->size << std::endl;
+            warn_out() << "Error: BDB record size exceeds MAX_BUFFER_SIZE limit. Key req: " << keyt->size << ", Val req: " << valt->size << std::endl;
             return DB_BUFFER_SMALL; // Return the error code, let caller handle it
         }
         try {
@@ -203,7 +261,7 @@ int db_cursor_get(DBC* cursor, DBT* keyt, DBT* valt, uint32_t flags,
             if (key_buf.size() < keyt->size) key_buf.resize(keyt->size + 1024);
             if (val_buf.size() < valt->size) val_buf.resize(valt->size + 1024);
         } catch (const std::bad_alloc& ba) {
-            std::cerr << "Error: Memory allocation failed resizing BDB buffer: " << ba.what() << std::endl;
+            warn_out() << "Error: Memory allocation failed resizing BDB buffer: " << ba.what() << std::endl;
             return -1; // Indicate critical memory error
         }
         // Update DBT pointers and sizes after resize
@@ -212,7 +270,7 @@ int db_cursor_get(DBC* cursor, DBT* keyt, DBT* valt, uint32_t flags,
         // Retry getting the *same* record (usually DB_CURRENT is the right flag here)
         ret = cursor->c_get(cursor, keyt, valt, DB_CURRENT);
         if (ret != 0) {
-             std::cerr << "Error: Failed BDB c_get (DB_CURRENT) after resize: " << db_strerror(ret) << std::endl;
+             warn_out() << "Error: Failed BDB c_get (DB_CURRENT) after resize: " << db_strerror(ret) << std::endl;
         }
     }
     return ret;
@@ -226,16 +284,16 @@ bool read_all_bdb(const char* walletfile, WalletDataMap& data_map) {
     int ret = 0;
     bool success = false;
 
-    std::cout << "Info: Attempting to read all data from BDB: " << walletfile << std::endl;
+    info_out() << "Info: Attempting to read all data from BDB: " << walletfile << std::endl;
     ret = db_create(&dbp, nullptr, 0);
-    if (ret != 0) { std::cerr << "Error (BDB read_all): db_create failed: " << db_strerror(ret) << std::endl; return false; }
+    if (ret != 0) { warn_out() << "Error (BDB read_all): db_create failed: " << db_strerror(ret) << std::endl; return false; }
 
     // Ensure 'main' dbname is used
     ret = dbp->open(dbp, nullptr, walletfile, "main", DB_BTREE, DB_RDONLY | DB_THREAD, 0);
-    if (ret != 0) { std::cerr << "Error (BDB read_all): dbp->open ('" << walletfile << "', 'main') failed: " << db_strerror(ret) << std::endl; if (dbp) dbp->close(dbp, 0); return false; }
+    if (ret != 0) { warn_out() << "Error (BDB read_all): dbp->open ('" << walletfile << "', 'main') failed: " << db_strerror(ret) << std::endl; if (dbp) dbp->close(dbp, 0); return false; }
 
     ret = dbp->cursor(dbp, nullptr, &cursor, 0);
-    if (ret != 0) { std::cerr << "Error (BDB read_all): dbp->cursor failed: " << db_strerror(ret) << std::endl; dbp->close(dbp, 0); return false; }
+    if (ret != 0) { warn_out() << "Error (BDB read_all): dbp->cursor failed: " << db_strerror(ret) << std::endl; dbp->close(dbp, 0); return false; }
 
     DBT keyt = {0}, valt = {0};
     std::vector<uint8_t> key_buf(INITIAL_BUFFER_SIZE);
@@ -243,6 +301,7 @@ bool read_all_bdb(const char* walletfile, WalletDataMap& data_map) {
     int record_count = 0;
 
     while ((ret = db_cursor_get(cursor, &keyt, &valt, DB_NEXT, key_buf, val_buf)) == 0) {
+        DETAILS_PROBE(record, keyt.size, valt.size);
         try {
              // Copy data into the map (Ensure size is correct from DBT)
              std::vector<uint8_t> current_key(static_cast<uint8_t*>(keyt.data), static_cast<uint8_t*>(keyt.data) + keyt.size);
@@ -250,20 +309,20 @@ bool read_all_bdb(const char* walletfile, WalletDataMap& data_map) {
              data_map[std::move(current_key)] = std::move(current_value); // Use move semantics
              record_count++;
         } catch (const std::exception& e) {
-             std:: cerr << "Error processing BDB record " << record_count << ": " << e.what() << std::endl;
+             warn_out() << "Error processing BDB record " << record_count << ": " << e.what() << std::endl;
              // Optionally break or continue on error
         }
     }
 
     if (ret != DB_NOTFOUND) { // DB_NOTFOUND is normal loop termination
-        std::cerr << "Error during BDB cursor iteration (read_all): " << db_strerror(ret);
-        if (ret == DB_BUFFER_SMALL) std::cerr << " (Stopped due to MAX_BUFFER_SIZE limit)";
-        else if (ret == -1) std::cerr << " (Stopped due to memory allocation failure)";
-        std::cerr << std::endl;
+        warn_out() << "Error during BDB cursor iteration (read_all): " << db_strerror(ret);
+        if (ret == DB_BUFFER_SMALL) warn_out() << " (Stopped due to MAX_BUFFER_SIZE limit)";
+        else if (ret == -1) warn_out() << " (Stopped due to memory allocation failure)";
+        warn_out() << std::endl;
         // success remains false
     } else {
         success = true; // Reached end of database successfully
-        std::cout << "Info: Successfully read " << record_count << " records from BDB." << std::endl;
+        info_out() << "Info: Successfully read " << record_count << " records from BDB." << std::endl;
     }
 
     if (cursor) cursor->c_close(cursor);
@@ -278,23 +337,35 @@ bool read_all_sqlite_special(const char* walletfile, WalletDataMap& data_map) {
     int rc = 0;
     bool success = false;
 
-    std::cout << "Info: Attempting to read all data from SQLite: " << walletfile << std::endl;
-    // Use URI for read-only mode if supported, otherwise fallback
-    rc = sqlite3_open_v2(walletfile, &db_sqlite, SQLITE_OPEN_READONLY, nullptr);
-    if (rc != SQLITE_OK) {
-         // Fallback to standard open if URI/RO failed
-         rc = sqlite3_open(walletfile, &db_sqlite);
-         if (rc != SQLITE_OK) {
-              std::cerr << "Error (SQLite read_all): Failed to open file '" << walletfile << "': " << sqlite3_errmsg(db_sqlite) << std::endl;
-              if(db_sqlite) sqlite3_close(db_sqlite);
-              return false;
-         }
-         std::cout << "Warning (SQLite read_all): Opened in read-write mode as read-only failed." << std::endl;
+    info_out() << "Info: Attempting to read all data from SQLite: " << walletfile << std::endl;
+    if (g_evidence_mode) {
+        // Evidence mode: immutable URI (no locks, no journal/WAL side files), never reopened read-write
+        std::string uri = sqlite_file_uri(walletfile) + "?immutable=1&nolock=1";
+        rc = sqlite3_open_v2(uri.c_str(), &db_sqlite, SQLITE_OPEN_READONLY | SQLITE_OPEN_URI, nullptr);
+        if (rc != SQLITE_OK) {
+            warn_out() << "Error (SQLite read_all): Failed to open file '" << walletfile << "' in evidence mode: " << sqlite3_errmsg(db_sqlite) << std::endl;
+            if(db_sqlite) sqlite3_close(db_sqlite);
+            return false;
+        }
+        sqlite3_exec(db_sqlite, "PRAGMA mmap_size=" EVIDENCE_MMAP_SIZE ";", nullptr, nullptr, nullptr);
+    } else {
+        // Use URI for read-only mode if supported, otherwise fallback
+        rc = sqlite3_open_v2(walletfile, &db_sqlite, SQLITE_OPEN_READONLY, nullptr);
+        if (rc != SQLITE_OK) {
+             // Fallback to standard open if URI/RO failed
+             rc = sqlite3_open(walletfile, &db_sqlite);
+             if (rc != SQLITE_OK) {
+                  warn_out() << "Error (SQLite read_all): Failed to open file '" << walletfile << "': " << sqlite3_errmsg(db_sqlite) << std::endl;
+                  if(db_sqlite) sqlite3_close(db_sqlite);
+                  return false;
+             }
+             info_out() << "Warning (SQLite read_all): Opened in read-write mode as read-only failed." << std::endl;
+        }
     }
 
     const char *sql = "SELECT key, value FROM main;";
     rc = sqlite3_prepare_v2(db_sqlite, sql, -1, &stmt, nullptr);
-    if (rc != SQLITE_OK) { std::cerr << "Error (SQLite read_all): Failed to prepare query '" << sql << "': " << sqlite3_errmsg(db_sqlite) << std::endl; sqlite3_close(db_sqlite); return false; }
+    if (rc != SQLITE_OK) { warn_out() << "Error (SQLite read_all): Failed to prepare query '" << sql << "': " << sqlite3_errmsg(db_sqlite) << std::endl; sqlite3_close(db_sqlite); return false; }
 
     int record_count = 0;
     while ((rc = sqlite3_step(stmt)) == SQLITE_ROW) {
@@ -306,6 +377,7 @@ bool read_all_sqlite_special(const char* walletfile, WalletDataMap& data_map) {
 
              // Check for null blobs or zero key size
              if (key_blob && key_size > 0 && value_blob) {
+                 DETAILS_PROBE(record, key_size, value_size);
                  // Cast void* to const uint8_t* for vector construction
                  const uint8_t *key_data = static_cast<const uint8_t*>(key_blob);
                  const uint8_t *value_data = static_cast<const uint8_t*>(value_blob);
@@ -315,20 +387,20 @@ bool read_all_sqlite_special(const char* walletfile, WalletDataMap& data_map) {
                  data_map[std::move(current_key)] = std::move(current_value); // Use move semantics
                  record_count++;
              } else {
-                  std::cerr << "Warning (SQLite read_all): Skipping record " << record_count << " due to null key/value or zero key size." << std::endl;
+                  warn_out() << "Warning (SQLite read_all): Skipping record " << record_count << " due to null key/value or zero key size." << std::endl;
              }
          } catch (const std::exception& e) {
-              std:: cerr << "Error processing SQLite record " << record_count << ": " << e.what() << std::endl;
+              warn_out() << "Error processing SQLite record " << record_count << ": " << e.what() << std::endl;
               // Optionally break or continue
          }
     }
 
     if (rc != SQLITE_DONE) {
-        std::cerr << "Error during SQLite step execution (read_all): " << sqlite3_errmsg(db_sqlite) << std::endl;
+        warn_out() << "Error during SQLite step execution (read_all): " << sqlite3_errmsg(db_sqlite) << std::endl;
         // success remains false
     } else {
         success = true; // Reached end of results successfully
-        std::cout << "Info: Successfully read " << record_count << " records from SQLite." << std::endl;
+        info_out() << "Info: Successfully read " << record_count << " records from SQLite." << std::endl;
     }
 
     sqlite3_finalize(stmt); // Finalize statement before closing DB
@@ -344,65 +416,181 @@ bool choose_and_read_all_data(const char* walletfile, WalletDataMap& data_map, D
     source_type = DbSourceType::UNKNOWN;
 
     if (ret_check != 0) {
-        std::cerr << "Error: Failed to create BDB check object: " << db_strerror(ret_check) << std::endl;
+        warn_out() << "Error: Failed to create BDB check object: " << db_strerror(ret_check) << std::endl;
         return false; // Cannot proceed without BDB check object
     }
 
-    std::cout << "Info: Attempting to open '" << walletfile << "' with BDB ('main' db) for format check..." << std::endl;
+    info_out() << "Info: Attempting to open '" << walletfile << "' with BDB ('main' db) for format check..." << std::endl;
     // Check specifically with "main" dbname
     ret_check = dbp_check->open(dbp_check, nullptr, walletfile, "main", DB_BTREE, DB_RDONLY | DB_THREAD, 0);
 
     if (ret_check == 0) {
         // BDB opened successfully with "main", this is likely a BDB wallet
-        std::cout << "Info: Detected BDB format ('main' database opened)." << std::endl;
+        info_out() << "Info: Detected BDB format ('main' database opened)." << std::endl;
         if (dbp_check) dbp_check->close(dbp_check, 0); // Close the check handle
         source_type = DbSourceType::BDB;
+        DETAILS_PROBE(backend, walletfile, static_cast<int>(source_type));
         read_ok = read_all_bdb(walletfile, data_map); // Read using the BDB reader
     } else {
         // BDB open failed (e.g., file not found, permission denied, or format error)
         std::string bdb_err_str = db_strerror(ret_check); // Get error string before closing
         if (dbp_check) dbp_check->close(dbp_check, 0); // Close the check handle
 
-        std::cout << "Info: BDB open failed (Reason: " << bdb_err_str << "). Attempting SQLite read as fallback." << std::endl;
+        info_out() << "Info: BDB open failed (Reason: " << bdb_err_str << "). Attempting SQLite read as fallback." << std::endl;
         source_type = DbSourceType::SQLITE_SPECIAL;
+        DETAILS_PROBE(backend, walletfile, static_cast<int>(source_type));
         read_ok = read_all_sqlite_special(walletfile, data_map); // Try reading using SQLite reader
 
         // If SQLite also fails, read_ok will remain false, and source_type will be SQLITE_SPECIAL (the last attempt)
     }
 
     if (!read_ok) {
-         std::cerr << "Error: Failed to read wallet data using both BDB and SQLite methods for file: " << walletfile << std::endl;
+         warn_out() << "Error: Failed to read wallet data using both BDB and SQLite methods for file: " << walletfile << std::endl;
     }
 
     return read_ok;
 }
+// --- Record Type Dispatch ---
+// Records are classified from the key's type tag (CompactSize length + ASCII tag) without building a string:
+// tags are bucketed by length and compared as one little-endian uint64 of their first 8 bytes, with a memcmp
+// of the rest only for longer tags. Lookup cost doesn't depend on how many types are registered.
+enum class RecordType {
+    UNKNOWN, MKEY, KEY, CKEY, NAME, KEYMETA,
+    // Registered but not parsed yet
+    HDCHAIN, POOL, WALLETDESCRIPTOR, WALLETDESCRIPTORCACHE, WALLETDESCRIPTORLHCACHE, WALLETDESCRIPTORKEY,
+    WALLETDESCRIPTORCKEY, ACTIVEEXTERNALSPK, ACTIVEINTERNALSPK, TX, VERSION, MINVERSION, BESTBLOCK,
+    BESTBLOCK_NOMERKLE, DEFAULTKEY, ORDERPOSNEXT, PURPOSE, DESTDATA, CSCRIPT, WATCHS, WATCHMETA, WKEY,
+    FLAGS, LOCKEDUTXO
+};
+
+struct RecordTypeInfo { const char* tag; RecordType type; };
+
+// Registration table: add a row here (and a case in parse_data_from_map to parse it)
+static const RecordTypeInfo RECORD_TYPES[] = {
+    {"mkey", RecordType::MKEY},
+    {"key", RecordType::KEY},
+    {"ckey", RecordType::CKEY},
+    {"name", RecordType::NAME},
+    {"keymeta", RecordType::KEYMETA},
+    {"hdchain", RecordType::HDCHAIN},
+    {"pool", RecordType::POOL},
+    {"walletdescriptor", RecordType::WALLETDESCRIPTOR},
+    {"walletdescriptorcache", RecordType::WALLETDESCRIPTORCACHE},
+    {"walletdescriptorlhcache", RecordType::WALLETDESCRIPTORLHCACHE},
+    {"walletdescriptorkey", RecordType::WALLETDESCRIPTORKEY},
+    {"walletdescriptorckey", RecordType::WALLETDESCRIPTORCKEY},
+    {"activeexternalspk", RecordType::ACTIVEEXTERNALSPK},
+    {"activeinternalspk", RecordType::ACTIVEINTERNALSPK},
+    {"tx", RecordType::TX},
+    {"version", RecordType::VERSION},
+    {"minversion", RecordType::MINVERSION},
+    {"bestblock", RecordType::BESTBLOCK},
+    {"bestblock_nomerkle", RecordType::BESTBLOCK_NOMERKLE},
+    {"defaultkey", RecordType::DEFAULTKEY},
+    {"orderposnext", RecordType::ORDERPOSNEXT},
+    {"purpose", RecordType::PURPOSE},
+    {"destdata", RecordType::DESTDATA},
+    {"cscript", RecordType::CSCRIPT},
+    {"watchs", RecordType::WATCHS},
+    {"watchmeta", RecordType::WATCHMETA},
+    {"wkey", RecordType::WKEY},
+    {"flags", RecordType::FLAGS},
+    {"lockedutxo", RecordType::LOCKEDUTXO},
+};
+const size_t MAX_RECORD_TAG_LENGTH = 32;
+
+// First (up to) 8 tag bytes as a little-endian word, zero padded
+static inline uint64_t tag_head_word(const uint8_t* p, size_t len) {
+    uint64_t w = 0;
+    for (size_t i = 0; i < len && i < 8; ++i) w |= static_cast<uint64_t>(p[i]) << (8 * i);
+    return w;
+}
+
+struct RecordTagEntry { uint64_t head; const char* tag; RecordType type; };
+
+// Built once (thread-safe static init) from RECORD_TYPES: entries per tag length
+static const std::vector<RecordTagEntry>* record_tag_buckets() {
+    static const std::vector<std::vector<RecordTagEntry>> buckets = []() {
+        std::vector<std::vector<RecordTagEntry>> b(MAX_RECORD_TAG_LENGTH + 1);
+        for (const auto& info : RECORD_TYPES) {
+            size_t len = strlen(info.tag);
+            if (len <= MAX_RECORD_TAG_LENGTH) b[len].push_back({tag_head_word(reinterpret_cast<const uint8_t*>(info.tag), len), info.tag, info.type});
+        }
+        return b;
+    }();
+    return buckets.data();
+}
+
+static const char* record_type_name(RecordType type) {
+    for (const auto& info : RECORD_TYPES) if (info.type == type) return info.tag;
+    return "unknown";
+}
+
+// Classifies a record key and sets tag_end to the offset just past the type tag.
+// Throws SerializationError if the key is too short for its own tag.
+static RecordType classify_record_key(const uint8_t* key, size_t len, size_t& tag_end) {
+    if (len == 0) throw SerializationError("Empty key");
+    size_t tag_len = key[0];
+    if (tag_len >= 253) { // Multi-byte CompactSize: longer than any registered tag
+        BCDataStream s; s.setInput(key, len);
+        uint64_t n = s.readCompactSize();
+        if (n > s.size()) throw SerializationError("Type tag length exceeds key");
+        tag_end = s.getCursor() + static_cast<size_t>(n);
+        return RecordType::UNKNOWN;
+    }
+    if (1 + tag_len > len) throw SerializationError("Type tag length exceeds key");
+    tag_end = 1 + tag_len;
+    if (tag_len > MAX_RECORD_TAG_LENGTH) return RecordType::UNKNOWN;
+
+    uint64_t head = tag_head_word(key + 1, tag_len);
+    for (const RecordTagEntry& e : record_tag_buckets()[tag_len]) {
+        if (e.head == head && (tag_len <= 8 || memcmp(key + 9, e.tag + 8, tag_len - 8) == 0)) return e.type;
+    }
+    return RecordType::UNKNOWN;
+}
+
 // --- Data Parsing Functions (Operating on the map) ---
 
-// Parses all known record types from the in-memory map
-bool parse_data_from_map(
-    const WalletDataMap& data_map,
-    DbSourceType source_type, // Source is now mainly for context/debugging
-    MKeyData& mkey_data,
-    std::vector<KeyData>& keys,
-    std::map<std::vector<uint8_t>, uint32_t>& pubkey_timestamps,
-    std::vector<AddressData>& addresses)
-{
-    BCDataStream kds, vds;
-    int parsed_mkey = 0, parsed_keys = 0, parsed_names = 0, parsed_meta = 0;
-    bool overall_success = true; // Tracks if any record failed parsing
+const size_t PARALLEL_PARSE_MIN_RECORDS = 50000; // Smaller wallets are parsed on the calling thread
+const size_t PARSE_CHUNK_RECORDS = 4096;           // Records per range claimed by a parse worker
 
-    std::cout << "Info: Parsing " << data_map.size() << " records from in-memory map..." << std::endl;
+// Worker threads for parse_data_from_map on large wallets (-j); 1 = always sequential
+static unsigned g_parse_threads = 1;
 
-    // Define the special SQLite mkey key constant
-    const std::vector<uint8_t> SQLITE_MKEY_CONST_KEY = {0x04, 'm', 'k', 'e', 'y', 0x01, 0x00, 0x00, 0x00};
+// What one record range produced. Ranges are merged in record order, so the result (and the order of
+// messages) is the same as a sequential parse.
+struct ParseResult {
+    MKeyData mkey_data;
+    std::vector<KeyData> keys;
+    std::map<std::vector<uint8_t>, uint32_t> pubkey_timestamps;
+    std::vector<AddressData> addresses;
+    int parsed_mkey = 0, parsed_keys = 0, parsed_names = 0, parsed_meta = 0;
+    bool overall_success = true; // Tracks if any record failed parsing
+};
 
-    for (const auto& pair : data_map) {
+// Parses the records in [first, last) into `result`; Info lines go to `info`, warnings to `warn`
+static void parse_record_range(WalletDataMap::const_iterator first, WalletDataMap::const_iterator last,
+                               ParseResult& result, std::ostream& info, std::ostream& warn)
+{
+    BCDataStream kds, vds;
+    MKeyData& mkey_data = result.mkey_data;
+    std::vector<KeyData>& keys = result.keys;
+    std::map<std::vector<uint8_t>, uint32_t>& pubkey_timestamps = result.pubkey_timestamps;
+    std::vector<AddressData>& addresses = result.addresses;
+    int& parsed_mkey = result.parsed_mkey;
+    int& parsed_keys = result.parsed_keys;
+    int& parsed_names = result.parsed_names;
+    int& parsed_meta = result.parsed_meta;
+    bool& overall_success = result.overall_success;
+
+    for (auto it = first; it != last; ++it) {
+        const auto& pair = *it;
         const std::vector<uint8_t>& raw_key = pair.first;
         const std::vector<uint8_t>& raw_value = pair.second;
 
         // Skip empty keys or values if they somehow exist
         if (raw_key.empty() || raw_value.empty()) {
-             std::cerr << "Warning: Skipping record with empty key or value." << std::endl;
+             warn << "Warning: Skipping record with empty key or value." << std::endl;
              continue;
         }
 
@@ -411,39 +599,30 @@ bool parse_data_from_map(
         kds.setInput(raw_key);
         vds.setInput(raw_value);
 
-        std::string type;
-        bool is_mkey_record = false;
+        RecordType type = RecordType::UNKNOWN;
 
-        // --- Determine record type and if it's the mkey ---
+        // --- Determine record type from the key's type tag ---
+        // (The SQLite mkey key 04 'mkey' 01000000 carries the same tag as the BDB one.)
         try {
-            // For SQLite, check if the key matches the special mkey constant
-            if (source_type == DbSourceType::SQLITE_SPECIAL && raw_key == SQLITE_MKEY_CONST_KEY) {
-                type = "mkey"; // Treat it as type "mkey" for unified logic
-                is_mkey_record = true;
-                 //std::cout << "DEBUG: Found SQLite special mkey constant key." << std::endl;
-            } else {
-                // For BDB (or potentially other records in SQLite), parse type from key
-                type = kds.readStringWithCompactSize(); // Read type from key stream
-                 if (type == "mkey") {
-                     is_mkey_record = true;
-                     //std::cout << "DEBUG: Found 'mkey' type string in key." << std::endl;
-                 }
-            }
+            size_t tag_end = 0;
+            type = classify_record_key(raw_key.data(), raw_key.size(), tag_end);
+            kds.setCursor(tag_end); // Rest of the key stream follows the tag
         } catch (const SerializationError& e) {
-            std::cerr << "Warning: Failed to parse key header for record with key [" << toHex(raw_key) << "]: " << e.what() << std::endl;
+            warn << "Warning: Failed to parse key header for record with key [" << toHex(raw_key) << "]: " << e.what() << std::endl;
             overall_success = false;
             continue; // Skip this record
         } catch (const std::exception& e) { // Catch other potential errors like bad_alloc
-            std::cerr << "Warning: Unexpected error parsing key header for record with key [" << toHex(raw_key) << "]: " << e.what() << std::endl;
+            warn << "Warning: Unexpected error parsing key header for record with key [" << toHex(raw_key) << "]: " << e.what() << std::endl;
             overall_success = false;
             continue;
         }
 
         // --- Process based on determined type ---
         try {
-            if (is_mkey_record) {
+            switch (type) {
+            case RecordType::MKEY: {
                 if (mkey_data.found) { // Should only be one mkey
-                    std::cerr << "Warning: Found multiple 'mkey' records in map. Using first one found." << std::endl;
+                    warn << "Warning: Found multiple 'mkey' records in map. Using first one found." << std::endl;
                     continue; // Skip subsequent mkey records
                 }
                 //std::cout << "DEBUG: Parsing value for mkey record..." << std::endl;
@@ -473,17 +652,20 @@ bool parse_data_from_map(
                 // Validate parsed mkey data (basic check)
                 if (!mkey_data.salt.empty() && !mkey_data.encrypted_key.empty()) {
                     mkey_data.found = true;
-                    parsed_mkey++;
-                    std::cout << "Info: Successfully parsed 'mkey' data." << std::endl;
+                    parsed_mkey++; // mkey_found fires once per wallet, from parse_data_from_map
+                    info << "Info: Successfully parsed 'mkey' data." << std::endl;
                     //std::cout << "DEBUG: Parsed Salt Hex: " << toHex(mkey_data.salt) << std::endl;
                     //std::cout << "DEBUG: Parsed Method: " << mkey_data.derivationMethod << std::endl;
                     //std::cout << "DEBUG: Parsed Iterations: " << mkey_data.derivationIterations << std::endl;
                 } else {
                     throw SerializationError("Parsed mkey is invalid (e.g., empty salt or key)");
                 }
+                break;
+            }
 
             // --- Key/CKey Parsing ---
-            } else if (type == "key" || type == "ckey") {
+            case RecordType::KEY:
+            case RecordType::CKEY: {
                 KeyData kd;
                 // Read public key from the rest of the key stream (kds)
                 // Assuming key format is: CompactSize(type_len), type_str, CompactSize(pubkey_len), pubkey_data
@@ -507,9 +689,11 @@ bool parse_data_from_map(
 
                 keys.push_back(std::move(kd)); // Use move
                 parsed_keys++;
+                break;
+            }
 
             // --- Name Parsing ---
-            } else if (type == "name") {
+            case RecordType::NAME: {
                  AddressData ad;
                  // Read address string from the rest of the key stream (kds)
                  // Assuming key format: CompactSize(type_len), "name", CompactSize(addr_len), addr_str
@@ -521,9 +705,11 @@ bool parse_data_from_map(
 
                  addresses.push_back(std::move(ad)); // Use move
                  parsed_names++;
+                 break;
+            }
 
             // --- KeyMeta Parsing ---
-            } else if (type == "keymeta") {
+            case RecordType::KEYMETA: {
                 // Read pubkey from key stream (kds)
                 // Assuming key format: CompactSize(type_len), "keymeta", CompactSize(pubkey_len), pubkey_data
                 uint64_t pubkey_len = kds.readCompactSize(); // Read after type string
@@ -538,24 +724,101 @@ bool parse_data_from_map(
                     pubkey_timestamps[keymeta_pubkey] = timestamp; // Store timestamp keyed by pubkey
                     parsed_meta++;
                 } else { throw SerializationError("Keymeta value too short for version+timestamp"); }
+                break;
+            }
+            // --- Add handling for other registered types here ---
+            default:
+                break;
             }
-            // --- Add handling for other known types if necessary ---
         } catch (const SerializationError& e) {
-            std::cerr << "Warning: Failed to parse record type '" << type << "' with key [" << toHex(raw_key) << "]: " << e.what() << std::endl;
+            warn << "Warning: Failed to parse record type '" << record_type_name(type) << "' with key [" << toHex(raw_key) << "]: " << e.what() << std::endl;
             overall_success = false; // Mark as partially failed if any record fails
         } catch (const std::exception& e) {
-            std::cerr << "Warning: Unexpected error parsing record type '" << type << "' with key [" << toHex(raw_key) << "]: " << e.what() << std::endl;
+            warn << "Warning: Unexpected error parsing record type '" << record_type_name(type) << "' with key [" << toHex(raw_key) << "]: " << e.what() << std::endl;
             overall_success = false;
         }
-    } // End map iteration
+    } // End range iteration
+}
 
-    std::cout << "Info: Parsing complete. Found: "
-              << parsed_mkey << " mkey, "
-              << parsed_keys << " keys, "
-              << parsed_names << " names, "
-              << parsed_meta << " keymeta." << std::endl;
+// Appends one range's results to `total`. Ranges must be merged in record order.
+static void merge_parse_result(ParseResult& part, ParseResult& total, std::ostream& warn) {
+    if (part.mkey_data.found) { // Counted only if taken: a sequential parse skips later mkeys before counting them
+        if (total.mkey_data.found) warn << "Warning: Found multiple 'mkey' records in map. Using first one found." << std::endl;
+        else { total.mkey_data = std::move(part.mkey_data); total.parsed_mkey += part.parsed_mkey; }
+    }
+    total.keys.insert(total.keys.end(), std::make_move_iterator(part.keys.begin()), std::make_move_iterator(part.keys.end()));
+    total.addresses.insert(total.addresses.end(), std::make_move_iterator(part.addresses.begin()), std::make_move_iterator(part.addresses.end()));
+    for (auto& ts : part.pubkey_timestamps) total.pubkey_timestamps[ts.first] = ts.second; // Later record wins, as in one pass
+    total.parsed_keys += part.parsed_keys;
+    total.parsed_names += part.parsed_names;
+    total.parsed_meta += part.parsed_meta;
+    total.overall_success = total.overall_success && part.overall_success;
+}
 
-    return overall_success; // Returns true if all records parsed without throwing, false otherwise
+// Large wallets: the map is cut into PARSE_CHUNK_RECORDS ranges that idle workers claim from a shared
+// counter (a range full of slow records doesn't hold up the others), each parsed into its own ParseResult.
+static void parse_records_parallel(const WalletDataMap& data_map, unsigned threads, ParseResult& total) {
+    std::vector<WalletDataMap::const_iterator> bounds;
+    size_t n = 0;
+    for (auto it = data_map.begin(); it != data_map.end(); ++it, ++n)
+        if (n % PARSE_CHUNK_RECORDS == 0) bounds.push_back(it);
+    bounds.push_back(data_map.end());
+    size_t chunks = bounds.size() - 1;
+
+    std::vector<ParseResult> parts(chunks);
+    std::vector<std::ostringstream> infos(chunks), warnings(chunks);
+    std::atomic<size_t> next{0};
+    auto worker = [&]() {
+        for (size_t c = next++; c < chunks; c = next++) parse_record_range(bounds[c], bounds[c + 1], parts[c], infos[c], warnings[c]);
+    };
+    std::vector<std::thread> pool;
+    for (size_t t = 1; t < std::min<size_t>(threads, chunks); ++t) pool.emplace_back(worker);
+    worker();
+    for (auto& th : pool) th.join();
+
+    for (size_t c = 0; c < chunks; ++c) {
+        info_out() << infos[c].str();
+        warn_out() << warnings[c].str();
+        merge_parse_result(parts[c], total, warn_out());
+    }
+}
+
+// Parses all known record types from the in-memory map
+bool parse_data_from_map(
+    const WalletDataMap& data_map,
+    MKeyData& mkey_data,
+    std::vector<KeyData>& keys,
+    std::map<std::vector<uint8_t>, uint32_t>& pubkey_timestamps,
+    std::vector<AddressData>& addresses)
+{
+    auto parse_started = std::chrono::steady_clock::now();
+
+    info_out() << "Info: Parsing " << data_map.size() << " records from in-memory map..." << std::endl;
+
+    ParseResult total;
+    total.keys.swap(keys); // Results are appended to what the caller passed in
+    total.addresses.swap(addresses);
+    total.pubkey_timestamps.swap(pubkey_timestamps);
+    if (g_parse_threads > 1 && data_map.size() >= PARALLEL_PARSE_MIN_RECORDS) {
+        parse_records_parallel(data_map, g_parse_threads, total);
+    } else {
+        parse_record_range(data_map.begin(), data_map.end(), total, info_out(), warn_out());
+    }
+    if (total.mkey_data.found) DETAILS_PROBE(mkey_found, total.mkey_data.derivationMethod, total.mkey_data.derivationIterations);
+    mkey_data = std::move(total.mkey_data);
+    keys.swap(total.keys);
+    addresses.swap(total.addresses);
+    pubkey_timestamps.swap(total.pubkey_timestamps);
+    DETAILS_PROBE(parse_done, static_cast<uint64_t>(data_map.size()), total.parsed_keys, total.parsed_names,
+                  static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - parse_started).count()));
+
+    info_out() << "Info: Parsing complete. Found: "
+              << total.parsed_mkey << " mkey, "
+              << total.parsed_keys << " keys, "
+              << total.parsed_names << " names, "
+              << total.parsed_meta << " keymeta." << std::endl;
+
+    return total.overall_success; // Returns true if all records parsed without throwing, false otherwise
 }
 
 // --- print_info (Operates on parsed data structs) ---
@@ -631,43 +894,705 @@ void print_info(
     std::cout << "--- End Wallet Info ---\n\n";
 }
 
+// --- Hashing (hash160 for the cross-wallet index) ---
+static const uint32_t SHA256_K[64] = {
+    0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+    0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+    0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+    0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+    0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13, 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+    0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+    0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+    0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208, 0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2
+};
+
+static inline uint32_t rotr32(uint32_t x, unsigned n) { return (x >> n) | (x << (32 - n)); }
+static inline uint32_t rotl32(uint32_t x, unsigned n) { return (x << n) | (x >> (32 - n)); }
+
+static void sha256_compress(uint32_t state[8], const uint8_t block[64]) {
+    uint32_t w[64];
+    for (int t = 0; t < 16; ++t)
+        w[t] = (uint32_t(block[t * 4]) << 24) | (uint32_t(block[t * 4 + 1]) << 16) | (uint32_t(block[t * 4 + 2]) << 8) | block[t * 4 + 3];
+    for (int t = 16; t < 64; ++t) {
+        uint32_t s0 = rotr32(w[t-15], 7) ^ rotr32(w[t-15], 18) ^ (w[t-15] >> 3);
+        uint32_t s1 = rotr32(w[t-2], 17) ^ rotr32(w[t-2], 19) ^ (w[t-2] >> 10);
+        w[t] = w[t-16] + s0 + w[t-7] + s1;
+    }
+    uint32_t a = state[0], b = state[1], c = state[2], d = state[3], e = state[4], f = state[5], g = state[6], h = state[7];
+    for (int t = 0; t < 64; ++t) {
+        uint32_t t1 = h + (rotr32(e, 6) ^ rotr32(e, 11) ^ rotr32(e, 25)) + ((e & f) ^ (~e & g)) + SHA256_K[t] + w[t];
+        uint32_t t2 = (rotr32(a, 2) ^ rotr32(a, 13) ^ rotr32(a, 22)) + ((a & b) ^ (a & c) ^ (b & c));
+        h = g; g = f; f = e; e = d + t1; d = c; c = b; b = a; a = t1 + t2;
+    }
+    state[0] += a; state[1] += b; state[2] += c; state[3] += d; state[4] += e; state[5] += f; state[6] += g; state[7] += h;
+}
+
+static void sha256(const uint8_t* data, size_t len, uint8_t out[32]) {
+    uint32_t state[8] = { 0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a, 0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19 };
+    size_t off = 0;
+    for (; off + 64 <= len; off += 64) sha256_compress(state, data + off);
+    uint8_t tail[128] = {0};
+    size_t rem = len - off;
+    if (rem) memcpy(tail, data + off, rem);
+    tail[rem] = 0x80;
+    size_t tail_len = (rem + 9 <= 64) ? 64 : 128;
+    uint64_t bit_len = static_cast<uint64_t>(len) * 8;
+    for (int i = 0; i < 8; ++i) tail[tail_len - 1 - i] = static_cast<uint8_t>(bit_len >> (i * 8));
+    for (size_t b = 0; b < tail_len; b += 64) sha256_compress(state, tail + b);
+    for (int i = 0; i < 8; ++i)
+        for (int j = 0; j < 4; ++j) out[i * 4 + j] = static_cast<uint8_t>(state[i] >> (24 - j * 8));
+}
+
+// RIPEMD-160: message word order and rotate amounts for the left and right lines
+static const uint8_t RMD_R1[80] = {
+    0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15,   7, 4, 13, 1, 10, 6, 15, 3, 12, 0, 9, 5, 2, 14, 11, 8,
+    3, 10, 14, 4, 9, 15, 8, 1, 2, 7, 0, 6, 13, 11, 5, 12,   1, 9, 11, 10, 0, 8, 12, 4, 13, 3, 7, 15, 14, 5, 6, 2,
+    4, 0, 5, 9, 7, 12, 2, 10, 14, 1, 3, 8, 11, 6, 15, 13 };
+static const uint8_t RMD_R2[80] = {
+    5, 14, 7, 0, 9, 2, 11, 4, 13, 6, 15, 8, 1, 10, 3, 12,   6, 11, 3, 7, 0, 13, 5, 10, 14, 15, 8, 12, 4, 9, 1, 2,
+    15, 5, 1, 3, 7, 14, 6, 9, 11, 8, 12, 2, 10, 0, 4, 13,   8, 6, 4, 1, 3, 11, 15, 0, 5, 12, 2, 13, 9, 7, 10, 14,
+    12, 15, 10, 4, 1, 5, 8, 7, 6, 2, 13, 14, 0, 3, 9, 11 };
+static const uint8_t RMD_S1[80] = {
+    11, 14, 15, 12, 5, 8, 7, 9, 11, 13, 14, 15, 6, 7, 9, 8,  7, 6, 8, 13, 11, 9, 7, 15, 7, 12, 15, 9, 11, 7, 13, 12,
+    11, 13, 6, 7, 14, 9, 13, 15, 14, 8, 13, 6, 5, 12, 7, 5,  11, 12, 14, 15, 14, 15, 9, 8, 9, 14, 5, 6, 8, 6, 5, 12,
+    9, 15, 5, 11, 6, 8, 13, 12, 5, 12, 13, 14, 11, 8, 5, 6 };
+static const uint8_t RMD_S2[80] = {
+    8, 9, 9, 11, 13, 15, 15, 5, 7, 7, 8, 11, 14, 14, 12, 6,  9, 13, 15, 7, 12, 8, 9, 11, 7, 7, 12, 7, 6, 15, 13, 11,
+    9, 7, 15, 11, 8, 6, 6, 14, 12, 13, 5, 14, 13, 13, 7, 5,  15, 5, 8, 11, 14, 14, 6, 14, 6, 9, 12, 9, 12, 5, 15, 8,
+    8, 5, 12, 9, 12, 5, 14, 6, 8, 13, 6, 5, 15, 13, 11, 11 };
+static const uint32_t RMD_K1[5] = { 0x00000000, 0x5a827999, 0x6ed9eba1, 0x8f1bbcdc, 0xa953fd4e };
+static const uint32_t RMD_K2[5] = { 0x50a28be6, 0x5c4dd124, 0x6d703ef3, 0x7a6d76e9, 0x00000000 };
+
+static inline uint32_t rmd_f(int j, uint32_t x, uint32_t y, uint32_t z) {
+    if (j < 16) return x ^ y ^ z;
+    if (j < 32) return (x & y) | (~x & z);
+    if (j < 48) return (x | ~y) ^ z;
+    if (j < 64) return (x & z) | (y & ~z);
+    return x ^ (y | ~z);
+}
+
+static void ripemd160_compress(uint32_t h[5], const uint8_t block[64]) {
+    uint32_t x[16];
+    for (int i = 0; i < 16; ++i)
+        x[i] = block[i * 4] | (uint32_t(block[i * 4 + 1]) << 8) | (uint32_t(block[i * 4 + 2]) << 16) | (uint32_t(block[i * 4 + 3]) << 24);
+    uint32_t a1 = h[0], b1 = h[1], c1 = h[2], d1 = h[3], e1 = h[4];
+    uint32_t a2 = h[0], b2 = h[1], c2 = h[2], d2 = h[3], e2 = h[4];
+    for (int j = 0; j < 80; ++j) {
+        uint32_t t = rotl32(a1 + rmd_f(j, b1, c1, d1) + x[RMD_R1[j]] + RMD_K1[j / 16], RMD_S1[j]) + e1;
+        a1 = e1; e1 = d1; d1 = rotl32(c1, 10); c1 = b1; b1 = t;
+        t = rotl32(a2 + rmd_f(79 - j, b2, c2, d2) + x[RMD_R2[j]] + RMD_K2[j / 16], RMD_S2[j]) + e2;
+        a2 = e2; e2 = d2; d2 = rotl32(c2, 10); c2 = b2; b2 = t;
+    }
+    uint32_t t = h[1] + c1 + d2;
+    h[1] = h[2] + d1 + e2; h[2] = h[3] + e1 + a2; h[3] = h[4] + a1 + b2; h[4] = h[0] + b1 + c2; h[0] = t;
+}
+
+static void ripemd160(const uint8_t* data, size_t len, uint8_t out[20]) {
+    uint32_t h[5] = { 0x67452301, 0xefcdab89, 0x98badcfe, 0x10325476, 0xc3d2e1f0 };
+    size_t off = 0;
+    for (; off + 64 <= len; off += 64) ripemd160_compress(h, data + off);
+    uint8_t tail[128] = {0};
+    size_t rem = len - off;
+    if (rem) memcpy(tail, data + off, rem);
+    tail[rem] = 0x80;
+    size_t tail_len = (rem + 9 <= 64) ? 64 : 128;
+    uint64_t bit_len = static_cast<uint64_t>(len) * 8;
+    for (int i = 0; i < 8; ++i) tail[tail_len - 8 + i] = static_cast<uint8_t>(bit_len >> (i * 8));
+    for (size_t b = 0; b < tail_len; b += 64) ripemd160_compress(h, tail + b);
+    for (int i = 0; i < 5; ++i)
+        for (int j = 0; j < 4; ++j) out[i * 4 + j] = static_cast<uint8_t>(h[i] >> (j * 8));
+}
+
+// RIPEMD-160(SHA-256(data)): the 20-byte key hash inside P2PKH and P2WPKH addresses
+static void hash160(const uint8_t* data, size_t len, uint8_t out[20]) {
+    uint8_t digest[32];
+    sha256(data, len, digest);
+    ripemd160(digest, sizeof(digest), out);
+}
+
+// --- Address Decoding ---
+// Base58Check (P2PKH/P2SH, any version byte): 1 version byte + 20-byte hash + 4-byte double-SHA-256 checksum
+static bool decode_base58check_hash160(const std::string& address, uint8_t out[20]) {
+    static const char* alphabet = "123456789ABCDEFGHJKLMNPQRSTUVWXYZabcdefghijkmnopqrstuvwxyz";
+    if (address.empty() || address.size() > 64) return false;
+    std::vector<uint8_t> bytes; // Big-endian base-256 accumulator
+    size_t leading_zeros = 0;
+    while (leading_zeros < address.size() && address[leading_zeros] == '1') leading_zeros++;
+    for (char ch : address) {
+        const char* pos = strchr(alphabet, ch);
+        if (ch == '\0' || !pos) return false;
+        int carry = static_cast<int>(pos - alphabet);
+        for (auto it = bytes.rbegin(); it != bytes.rend(); ++it) {
+            carry += 58 * (*it);
+            *it = static_cast<uint8_t>(carry & 0xff);
+            carry >>= 8;
+        }
+        while (carry > 0) { bytes.insert(bytes.begin(), static_cast<uint8_t>(carry & 0xff)); carry >>= 8; }
+    }
+    bytes.insert(bytes.begin(), leading_zeros, 0);
+    if (bytes.size() != 25) return false;
+    uint8_t check[32];
+    sha256(bytes.data(), 21, check);
+    sha256(check, sizeof(check), check);
+    if (memcmp(check, bytes.data() + 21, 4) != 0) return false;
+    memcpy(out, bytes.data() + 1, 20);
+    return true;
+}
+
+static uint32_t bech32_polymod(const std::vector<uint8_t>& values) {
+    static const uint32_t gen[5] = { 0x3b6a57b2, 0x26508e6d, 0x1ea119fa, 0x3d4233dd, 0x2a1462b3 };
+    uint32_t chk = 1;
+    for (uint8_t v : values) {
+        uint8_t top = static_cast<uint8_t>(chk >> 25);
+        chk = ((chk & 0x1ffffff) << 5) ^ v;
+        for (int i = 0; i < 5; ++i) if ((top >> i) & 1) chk ^= gen[i];
+    }
+    return chk;
+}
+
+// Segwit (bech32/bech32m): only witness v0 20-byte programs (P2WPKH) carry a hash160
+static bool decode_segwit_hash160(const std::string& address, uint8_t out[20]) {
+    static const char* charset = "qpzry9x8gf2tvdw0s3jn54khce6mua7l";
+    std::string lower(address);
+    std::transform(lower.begin(), lower.end(), lower.begin(), ::tolower);
+    size_t sep = lower.rfind('1');
+    if (sep == std::string::npos || sep == 0 || sep + 7 > lower.size() || lower.size() > 90) return false;
+    std::vector<uint8_t> values;
+    for (size_t i = 0; i < sep; ++i) values.push_back(static_cast<uint8_t>(lower[i]) >> 5);
+    values.push_back(0);
+    for (size_t i = 0; i < sep; ++i) values.push_back(static_cast<uint8_t>(lower[i]) & 31);
+    std::vector<uint8_t> data;
+    for (size_t i = sep + 1; i < lower.size(); ++i) {
+        const char* pos = strchr(charset, lower[i]);
+        if (lower[i] == '\0' || !pos) return false;
+        data.push_back(static_cast<uint8_t>(pos - charset));
+    }
+    values.insert(values.end(), data.begin(), data.end());
+    uint32_t chk = bech32_polymod(values);
+    if (data.empty() || data[0] != 0 || chk != 1) return false; // v0 uses bech32 (constant 1)
+    std::vector<uint8_t> program;
+    uint32_t acc = 0;
+    int bits = 0;
+    for (size_t i = 1; i + 6 < data.size(); ++i) { // Skip the version and the 6 checksum characters
+        acc = (acc << 5) | data[i];
+        bits += 5;
+        if (bits >= 8) { bits -= 8; program.push_back(static_cast<uint8_t>(acc >> bits)); }
+    }
+    if (bits >= 5 || (acc & ((1u << bits) - 1)) != 0 || program.size() != 20) return false;
+    memcpy(out, program.data(), 20);
+    return true;
+}
+
+// Index key for a 'name' record address: the hash160 it encodes when it has one (so it joins with
+// key/ckey pubkeys), otherwise hash160 of the address text (P2WSH, taproot, unknown formats).
+static bool address_index_key(const std::string& address, uint8_t out[20]) {
+    if (decode_base58check_hash160(address, out) || decode_segwit_hash160(address, out)) return true;
+    hash160(reinterpret_cast<const uint8_t*>(address.data()), address.size(), out);
+    return false;
+}
+
+// --- Cross-Wallet Index ---
+// Layout (little-endian):
+//   header (64 bytes): magic "WDXIDX1\0", u32 entry size, u32 reserved, u64 entries, u64 wallets,
+//                      u64 entries offset, u64 wallet table offset, u64 strings offset, u64 strings size
+//   entries:           hash160[20] + u32 tag (wallet id | INDEX_KIND_* bits), sorted by hash160 then wallet id,
+//                      one entry per (hash160, wallet)
+//   wallet table:      u64 offset into strings per wallet id; strings: NUL-terminated wallet paths
+static const char INDEX_MAGIC[8] = { 'W', 'D', 'X', 'I', 'D', 'X', '1', '\0' };
+const size_t INDEX_HEADER_SIZE = 64;
+const size_t INDEX_ENTRY_SIZE = 24;
+const uint32_t INDEX_KIND_PUBKEY = 1u << 30;  // Seen as the hash160 of a key/ckey pubkey
+const uint32_t INDEX_KIND_ADDRESS = 1u << 31; // Seen as a 'name' record address
+const uint32_t INDEX_WALLET_MASK = INDEX_KIND_PUBKEY - 1;
+const size_t INDEX_DEFAULT_MEM_MB = 1024;
+
+struct IndexEntry {
+    uint8_t hash[20];
+    uint32_t tag;
+    uint32_t wallet() const { return tag & INDEX_WALLET_MASK; }
+};
+
+static inline bool index_entry_less(const IndexEntry& a, const IndexEntry& b) {
+    int c = memcmp(a.hash, b.hash, sizeof(a.hash));
+    return c < 0 || (c == 0 && a.wallet() < b.wallet());
+}
+static inline bool index_entry_same(const IndexEntry& a, const IndexEntry& b) {
+    return a.wallet() == b.wallet() && memcmp(a.hash, b.hash, sizeof(a.hash)) == 0;
+}
+
+static void index_put_le32(uint8_t* p, uint32_t v) { for (int i = 0; i < 4; ++i) p[i] = static_cast<uint8_t>(v >> (i * 8)); }
+static void index_put_le64(uint8_t* p, uint64_t v) { for (int i = 0; i < 8; ++i) p[i] = static_cast<uint8_t>(v >> (i * 8)); }
+static uint32_t index_get_le32(const uint8_t* p) { uint32_t v = 0; for (int i = 3; i >= 0; --i) v = (v << 8) | p[i]; return v; }
+static uint64_t index_get_le64(const uint8_t* p) { uint64_t v = 0; for (int i = 7; i >= 0; --i) v = (v << 8) | p[i]; return v; }
+
+static std::string index_kind_name(uint32_t tag) {
+    if ((tag & INDEX_KIND_PUBKEY) && (tag & INDEX_KIND_ADDRESS)) return "pubkey+address";
+    return (tag & INDEX_KIND_PUBKEY) ? "pubkey" : "address";
+}
+
+// Sorts entries and merges duplicates of the same (hash160, wallet), OR-ing their kind bits
+static void sort_and_merge_entries(std::vector<IndexEntry>& entries) {
+    std::sort(entries.begin(), entries.end(), index_entry_less);
+    size_t out = 0;
+    for (size_t i = 0; i < entries.size(); ++i) {
+        if (out > 0 && index_entry_same(entries[out - 1], entries[i])) entries[out - 1].tag |= entries[i].tag;
+        else entries[out++] = entries[i];
+    }
+    entries.resize(out);
+}
+
+// Collects entries from parallel workers. Once the buffer reaches the memory limit it is sorted and
+// spilled to <index>.run<N>.tmp; finish() k-way merges the runs (and what is left in memory) into the index.
+class IndexBuilder {
+public:
+    IndexBuilder(const std::string& path, size_t mem_limit_bytes)
+        : path_(path), max_entries_(std::max<size_t>(mem_limit_bytes / sizeof(IndexEntry), 1024)) {}
+
+    ~IndexBuilder() { for (const auto& run : runs_) unlink(run.c_str()); }
+
+    // Thread-safe. Adds one wallet's pubkeys and addresses.
+    void add_wallet(uint32_t wallet_id, const std::vector<KeyData>& keys, const std::vector<AddressData>& addresses) {
+        std::vector<IndexEntry> local;
+        local.reserve(keys.size() + addresses.size());
+        for (const auto& k : keys) {
+            if (k.public_key.empty()) continue;
+            IndexEntry e;
+            hash160(k.public_key.data(), k.public_key.size(), e.hash);
+            e.tag = wallet_id | INDEX_KIND_PUBKEY;
+            local.push_back(e);
+        }
+        for (const auto& ad : addresses) {
+            if (ad.address.empty()) continue;
+            IndexEntry e;
+            address_index_key(ad.address, e.hash);
+            e.tag = wallet_id | INDEX_KIND_ADDRESS;
+            local.push_back(e);
+        }
+        sort_and_merge_entries(local);
+
+        std::vector<IndexEntry> spill;
+        std::string run_path;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            buffer_.insert(buffer_.end(), local.begin(), local.end());
+            if (buffer_.size() < max_entries_) return;
+            spill.swap(buffer_);
+            run_path = path_ + ".run" + std::to_string(runs_.size()) + ".tmp";
+            runs_.push_back(run_path);
+        }
+        // Sorted and written outside the lock so the other workers keep filling a fresh buffer
+        sort_and_merge_entries(spill);
+        std::ofstream run(run_path, std::ios::binary | std::ios::trunc);
+        run.write(reinterpret_cast<const char*>(spill.data()), spill.size() * sizeof(IndexEntry));
+        if (!run) {
+            std::cerr << "Error: Failed to write index run '" << run_path << "'." << std::endl;
+            failed_ = true;
+        }
+    }
+
+    // Call after all workers have finished. Writes the index and reports entry and shared-hash counts.
+    bool finish(const std::vector<std::string>& wallet_paths, uint64_t& entry_count, uint64_t& shared_count) {
+        entry_count = shared_count = 0;
+        if (failed_) return false;
+        sort_and_merge_entries(buffer_);
+
+        // Merge sources: every spilled run (streamed through a small buffer) plus the in-memory remainder
+        struct Source { std::ifstream in; std::vector<IndexEntry> buf; size_t pos = 0; };
+        const size_t RUN_READ_ENTRIES = 8192;
+        std::vector<std::unique_ptr<Source>> sources;
+        for (const auto& run : runs_) {
+            std::unique_ptr<Source> src(new Source);
+            src->in.open(run, std::ios::binary);
+            if (!src->in) { std::cerr << "Error: Cannot reopen index run '" << run << "'." << std::endl; return false; }
+            sources.push_back(std::move(src));
+        }
+        std::unique_ptr<Source> mem(new Source);
+        mem->buf.swap(buffer_);
+        sources.push_back(std::move(mem));
+        auto refill = [&](Source& src) {
+            if (src.pos < src.buf.size() || !src.in.is_open()) return src.pos < src.buf.size();
+            src.buf.resize(RUN_READ_ENTRIES);
+            src.in.read(reinterpret_cast<char*>(src.buf.data()), RUN_READ_ENTRIES * sizeof(IndexEntry));
+            src.buf.resize(static_cast<size_t>(src.in.gcount()) / sizeof(IndexEntry));
+            src.pos = 0;
+            return !src.buf.empty();
+        };
+        auto heap_greater = [&](size_t a, size_t b) {
+            return index_entry_less(sources[b]->buf[sources[b]->pos], sources[a]->buf[sources[a]->pos]);
+        };
+        std::priority_queue<size_t, std::vector<size_t>, decltype(heap_greater)> heap(heap_greater);
+        for (size_t i = 0; i < sources.size(); ++i) if (refill(*sources[i])) heap.push(i);
+
+        std::string tmp_path = path_ + ".tmp";
+        std::ofstream out(tmp_path, std::ios::binary | std::ios::trunc);
+        if (!out) { std::cerr << "Error: Cannot create index file '" << tmp_path << "'." << std::endl; return false; }
+        uint8_t header[INDEX_HEADER_SIZE] = {0};
+        out.write(reinterpret_cast<const char*>(header), sizeof(header));
+
+        std::vector<uint8_t> chunk;
+        chunk.reserve(RUN_READ_ENTRIES * INDEX_ENTRY_SIZE);
+        IndexEntry pending = {};
+        bool have_pending = false;
+        uint64_t group_wallets = 0;
+        auto flush_pending = [&]() {
+            size_t at = chunk.size();
+            chunk.resize(at + INDEX_ENTRY_SIZE);
+            memcpy(&chunk[at], pending.hash, sizeof(pending.hash));
+            index_put_le32(&chunk[at + 20], pending.tag);
+            entry_count++;
+            if (chunk.size() >= RUN_READ_ENTRIES * INDEX_ENTRY_SIZE) {
+                out.write(reinterpret_cast<const char*>(chunk.data()), chunk.size());
+                chunk.clear();
+            }
+        };
+        while (!heap.empty()) {
+            size_t i = heap.top();
+            heap.pop();
+            IndexEntry e = sources[i]->buf[sources[i]->pos++];
+            if (refill(*sources[i])) heap.push(i);
+            if (have_pending && index_entry_same(pending, e)) { pending.tag |= e.tag; continue; }
+            if (have_pending) {
+                bool same_hash = memcmp(pending.hash, e.hash, sizeof(e.hash)) == 0;
+                flush_pending();
+                if (!same_hash) { if (group_wallets >= 2) shared_count++; group_wallets = 0; }
+            }
+            pending = e;
+            have_pending = true;
+            group_wallets++;
+        }
+        if (have_pending) { flush_pending(); if (group_wallets >= 2) shared_count++; }
+        out.write(reinterpret_cast<const char*>(chunk.data()), chunk.size());
+
+        uint64_t entries_offset = INDEX_HEADER_SIZE;
+        uint64_t table_offset = entries_offset + entry_count * INDEX_ENTRY_SIZE;
+        uint64_t strings_offset = table_offset + wallet_paths.size() * 8;
+        uint64_t strings_size = 0;
+        uint8_t le[8];
+        for (const auto& p : wallet_paths) {
+            index_put_le64(le, strings_size);
+            out.write(reinterpret_cast<const char*>(le), sizeof(le));
+            strings_size += p.size() + 1;
+        }
+        for (const auto& p : wallet_paths) out.write(p.c_str(), p.size() + 1);
+
+        memcpy(header, INDEX_MAGIC, sizeof(INDEX_MAGIC));
+        index_put_le32(header + 8, INDEX_ENTRY_SIZE);
+        index_put_le64(header + 16, entry_count);
+        index_put_le64(header + 24, wallet_paths.size());
+        index_put_le64(header + 32, entries_offset);
+        index_put_le64(header + 40, table_offset);
+        index_put_le64(header + 48, strings_offset);
+        index_put_le64(header + 56, strings_size);
+        out.seekp(0);
+        out.write(reinterpret_cast<const char*>(header), sizeof(header));
+        out.close();
+        if (!out) { std::cerr << "Error: Failed to write index file '" << tmp_path << "'." << std::endl; unlink(tmp_path.c_str()); return false; }
+        if (rename(tmp_path.c_str(), path_.c_str()) != 0) {
+            std::cerr << "Error: Cannot rename '" << tmp_path << "' to '" << path_ << "': " << strerror(errno) << std::endl;
+            return false;
+        }
+        return true;
+    }
+
+private:
+    std::string path_;
+    size_t max_entries_;
+    std::mutex mutex_;
+    std::vector<IndexEntry> buffer_;
+    std::vector<std::string> runs_;
+    std::atomic<bool> failed_{false};
+};
+
+// Read-only view of an index file (mmap); lookups are a binary search over the sorted entries
+class IndexReader {
+public:
+    ~IndexReader() { if (base_) munmap(const_cast<uint8_t*>(base_), length_); }
+
+    bool open(const char* path) {
+        int fd = ::open(path, O_RDONLY);
+        if (fd < 0) { std::cerr << "Error: Cannot open index '" << path << "': " << strerror(errno) << std::endl; return false; }
+        struct stat st;
+        if (fstat(fd, &st) != 0 || st.st_size < static_cast<off_t>(INDEX_HEADER_SIZE)) {
+            std::cerr << "Error: '" << path << "' is not a wallet index (too short)." << std::endl;
+            ::close(fd);
+            return false;
+        }
+        length_ = static_cast<size_t>(st.st_size);
+        void* map = mmap(nullptr, length_, PROT_READ, MAP_PRIVATE, fd, 0);
+        ::close(fd);
+        if (map == MAP_FAILED) { std::cerr << "Error: Cannot map index '" << path << "': " << strerror(errno) << std::endl; return false; }
+        base_ = static_cast<const uint8_t*>(map);
+
+        entries_ = index_get_le64(base_ + 16);
+        wallets_ = index_get_le64(base_ + 24);
+        entries_offset_ = index_get_le64(base_ + 32);
+        table_offset_ = index_get_le64(base_ + 40);
+        strings_offset_ = index_get_le64(base_ + 48);
+        uint64_t strings_size = index_get_le64(base_ + 56);
+        bool valid = memcmp(base_, INDEX_MAGIC, sizeof(INDEX_MAGIC)) == 0
+                     && index_get_le32(base_ + 8) == INDEX_ENTRY_SIZE
+                     && entries_ <= length_ / INDEX_ENTRY_SIZE && wallets_ <= length_ / 8
+                     && entries_offset_ == INDEX_HEADER_SIZE
+                     && table_offset_ == entries_offset_ + entries_ * INDEX_ENTRY_SIZE
+                     && strings_offset_ == table_offset_ + wallets_ * 8
+                     && strings_offset_ <= length_ && strings_size == length_ - strings_offset_
+                     && (strings_size == 0 || base_[length_ - 1] == '\0');
+        if (!valid) { std::cerr << "Error: '" << path << "' is not a valid wallet index (bad header or truncated)." << std::endl; return false; }
+        return true;
+    }
+
+    uint64_t size() const { return entries_; }
+    const uint8_t* hash(uint64_t i) const { return base_ + entries_offset_ + i * INDEX_ENTRY_SIZE; }
+    uint32_t tag(uint64_t i) const { return index_get_le32(hash(i) + 20); }
+
+    const char* wallet_path(uint32_t id) const {
+        if (id >= wallets_) return "?";
+        uint64_t off = index_get_le64(base_ + table_offset_ + static_cast<uint64_t>(id) * 8);
+        return off < length_ - strings_offset_ ? reinterpret_cast<const char*>(base_ + strings_offset_ + off) : "?";
+    }
+
+    // First entry whose hash160 is >= key
+    uint64_t lower_bound(const uint8_t key[20]) const {
+        uint64_t lo = 0, hi = entries_;
+        while (lo < hi) {
+            uint64_t mid = lo + (hi - lo) / 2;
+            if (memcmp(hash(mid), key, 20) < 0) lo = mid + 1; else hi = mid;
+        }
+        return lo;
+    }
+
+private:
+    const uint8_t* base_ = nullptr;
+    size_t length_ = 0;
+    uint64_t entries_ = 0, wallets_ = 0, entries_offset_ = 0, table_offset_ = 0, strings_offset_ = 0;
+};
+
+// Parses every wallet with `threads` workers and writes the index. Wallet ids are positions in `files`.
+static int build_wallet_index(const std::vector<std::string>& files, const char* index_path, unsigned threads, size_t mem_mb) {
+    IndexBuilder builder(index_path, mem_mb * 1024 * 1024);
+    std::atomic<size_t> next{0};
+    std::atomic<uint64_t> indexed{0}, unreadable{0}, keys_total{0}, addresses_total{0};
+    std::mutex report_mutex;
+    auto worker = [&]() {
+        t_silent = true;
+        for (size_t i = next++; i < files.size(); i = next++) {
+            const char* f = files[i].c_str();
+            DETAILS_PROBE(file_start, f);
+            auto file_started = std::chrono::steady_clock::now();
+            WalletDataMap data_map;
+            DbSourceType source_type = DbSourceType::UNKNOWN;
+            bool read_success = choose_and_read_all_data(f, data_map, source_type) && !data_map.empty();
+            if (read_success) {
+                MKeyData mkey_data;
+                std::vector<KeyData> keys;
+                std::map<std::vector<uint8_t>, uint32_t> pubkey_timestamps;
+                std::vector<AddressData> addresses;
+                parse_data_from_map(data_map, mkey_data, keys, pubkey_timestamps, addresses);
+                builder.add_wallet(static_cast<uint32_t>(i), keys, addresses);
+                indexed++;
+                keys_total += keys.size();
+                addresses_total += addresses.size();
+            } else {
+                unreadable++;
+                std::lock_guard<std::mutex> lock(report_mutex);
+                std::cerr << "Warning: Skipping '" << f << "': not a readable wallet or empty." << std::endl;
+            }
+            DETAILS_PROBE(file_end, f, static_cast<int>(read_success),
+                          static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - file_started).count()));
+        }
+    };
+    std::vector<std::thread> pool;
+    for (unsigned t = 1; t < threads; ++t) pool.emplace_back(worker);
+    worker();
+    for (auto& th : pool) th.join();
+    t_silent = false;
+
+    uint64_t entry_count = 0, shared_count = 0;
+    if (!builder.finish(files, entry_count, shared_count)) return 1;
+    info_out() << "Info: Indexed " << indexed << " wallet(s) (" << unreadable << " unreadable): " << keys_total << " key(s), "
+               << addresses_total << " address(es) -> " << entry_count << " entries, " << shared_count
+               << " hash160(s) shared by 2+ wallets. Written to '" << index_path << "'." << std::endl;
+    return 0;
+}
+
+static bool parse_hex(const std::string& text, std::vector<uint8_t>& out) {
+    if (text.empty() || text.size() % 2 != 0) return false;
+    out.clear();
+    for (size_t i = 0; i < text.size(); i += 2) {
+        if (!isxdigit(static_cast<unsigned char>(text[i])) || !isxdigit(static_cast<unsigned char>(text[i + 1]))) return false;
+        out.push_back(static_cast<uint8_t>(std::stoi(text.substr(i, 2), nullptr, 16)));
+    }
+    return true;
+}
+
+// Query terms: a 40-hex hash160, a hex pubkey (33 or 65 bytes) or an address.
+// Prints term, hash160, kind and wallet path per match; returns 0 if anything matched.
+static int query_wallet_index(const char* index_path, const std::vector<std::string>& terms) {
+    IndexReader index;
+    if (!index.open(index_path)) return 2;
+    bool any = false;
+    for (const auto& term : terms) {
+        uint8_t key[20];
+        std::vector<uint8_t> raw;
+        if (term.size() == 40 && parse_hex(term, raw)) memcpy(key, raw.data(), 20);
+        else if ((term.size() == 66 || term.size() == 130) && parse_hex(term, raw)) hash160(raw.data(), raw.size(), key);
+        else address_index_key(term, key);
+
+        bool found = false;
+        for (uint64_t i = index.lower_bound(key); i < index.size() && memcmp(index.hash(i), key, 20) == 0; ++i) {
+            uint32_t tag = index.tag(i);
+            std::cout << term << "\t" << toHex(key, 20) << "\t" << index_kind_name(tag) << "\t" << index.wallet_path(tag & INDEX_WALLET_MASK) << "\n";
+            found = true;
+        }
+        if (!found) info_out() << "Info: '" << term << "' not found in index." << std::endl;
+        any = any || found;
+    }
+    std::cout.flush();
+    return any ? 0 : 1;
+}
+
+// One line per hash160 found in at least `min_wallets` wallets: hash160, kinds, count, then the wallet paths
+static int list_index_duplicates(const char* index_path, uint64_t min_wallets) {
+    IndexReader index;
+    if (!index.open(index_path)) return 2;
+    uint64_t groups = 0;
+    for (uint64_t i = 0; i < index.size();) {
+        uint64_t end = i + 1;
+        while (end < index.size() && memcmp(index.hash(end), index.hash(i), 20) == 0) end++;
+        if (end - i >= min_wallets) {
+            uint32_t kinds = 0;
+            for (uint64_t j = i; j < end; ++j) kinds |= index.tag(j);
+            std::cout << toHex(index.hash(i), 20) << "\t" << index_kind_name(kinds) << "\t" << (end - i);
+            for (uint64_t j = i; j < end; ++j) std::cout << "\t" << index.wallet_path(index.tag(j) & INDEX_WALLET_MASK);
+            std::cout << "\n";
+            groups++;
+        }
+        i = end;
+    }
+    std::cout.flush();
+    info_out() << "Info: " << groups << " hash160(s) shared by " << min_wallets << "+ wallets." << std::endl;
+    return 0;
+}
+
+// Collects .dat files (case-insensitive) from `dir`, prefixed with `prefix`. Returns false if it can't be opened.
+static bool collect_dat_files(const char* dir, const std::string& prefix, std::vector<std::string>& files) {
+    DIR* dp = opendir(dir);
+    if (!dp) {
+         // Use std::system_error for better OS error reporting
+         std::error_code ec(errno, std::system_category());
+         std::cerr << "Error opening directory '" << dir << "': " << ec.message() << std::endl;
+        return false;
+    }
+    struct dirent* ep;
+    while ((ep = readdir(dp)) != nullptr) {
+        // Skip "." and ".." entries
+        if (strcmp(ep->d_name, ".") == 0 || strcmp(ep->d_name, "..") == 0) {
+            continue;
+        }
+        std::string n(ep->d_name);
+        if (n.length() >= 4 && strcasecmp(n.c_str() + n.length() - 4, ".dat") == 0) {
+            files.push_back(prefix + n); // Add without stat check for simplicity
+        }
+    }
+    closedir(dp);
+    return true;
+}
+
+static void print_usage(const char* prog) {
+    std::cerr << "Usage: " << prog << " [--evidence] [-q] [wallet_file1.dat ...]\n"
+              << "       " << prog << " --index <out.idx> [-j N] [--index-mem MB] [--files-from <list>] [wallet.dat|dir ...]\n"
+              << "       " << prog << " --query-index <idx> <address|pubkey hex|hash160 hex> ...\n"
+              << "       " << prog << " --duplicates <idx> [--min-wallets N]\n"
+              << "Options:\n"
+              << "  --evidence           Open SQLite wallets immutable with no locking, never read-write\n"
+              << "  -q, --quiet          Don't print Info lines\n"
+              << "  --index <file>       Parse key/ckey/name records of all wallets in parallel and write a\n"
+              << "                       sorted hash160 -> wallet index (directories are scanned for .dat files)\n"
+              << "  --files-from <file>  Read wallet paths from <file>, one per line ('-' for STDIN)\n"
+              << "  -j, --threads <n>    Worker threads (default: number of CPUs): wallets parsed side by side with\n"
+              << "                       --index, otherwise record ranges of wallets with " << PARALLEL_PARSE_MIN_RECORDS << "+ records\n"
+              << "  --index-mem <MB>     Memory for index entries before sorted runs are spilled to disk (default: "
+              << INDEX_DEFAULT_MEM_MB << ")\n"
+              << "  --query-index <file> Print the wallets containing each address, pubkey or hash160\n"
+              << "  --duplicates <file>  Print every hash160 found in several wallets\n"
+              << "  --min-wallets <n>    Minimum wallets per hash160 for --duplicates (default: 2)\n";
+}
+
+#ifndef WALLET_NO_MAIN
 // --- main function (Revised structure) ---
 int main(int argc, char* argv[]) {
     std::vector<std::string> files;
-    // --- File finding logic ---
-    if (argc < 2) {
-        std::cout << "Info: No wallet file specified, scanning current directory for .dat files..." << std::endl;
-        DIR* dp = opendir(".");
-        if (!dp) {
-             // Use std::system_error for better OS error reporting
-             std::error_code ec(errno, std::system_category());
-             std::cerr << "Error opening current directory: " << ec.message() << std::endl;
-            return 1;
-        }
-        struct dirent* ep;
-        while ((ep = readdir(dp)) != nullptr) {
-            // Skip "." and ".." entries
-            if (strcmp(ep->d_name, ".") == 0 || strcmp(ep->d_name, "..") == 0) {
-                continue;
+    std::vector<std::string> args;
+    const char* index_out = nullptr;
+    const char* query_index = nullptr;
+    const char* duplicates_index = nullptr;
+    const char* files_from = nullptr;
+    unsigned threads = std::max(1u, std::thread::hardware_concurrency());
+    size_t index_mem_mb = INDEX_DEFAULT_MEM_MB;
+    uint64_t min_wallets = 2;
+    for (int i = 1; i < argc; i++) {
+        std::string a = argv[i];
+        bool has_value = i + 1 < argc;
+        if (a == "--evidence") { g_evidence_mode = true; continue; }
+        if (a == "-q" || a == "--quiet") { g_verbosity = 1; continue; }
+        if (a == "-h" || a == "--help") { print_usage(argv[0]); return 0; }
+        if (a == "--index" && has_value) { index_out = argv[++i]; continue; }
+        if (a == "--query-index" && has_value) { query_index = argv[++i]; continue; }
+        if (a == "--duplicates" && has_value) { duplicates_index = argv[++i]; continue; }
+        if (a == "--files-from" && has_value) { files_from = argv[++i]; continue; }
+        if ((a == "-j" || a == "--threads") && has_value) { threads = std::max(1, atoi(argv[++i])); continue; }
+        if (a == "--index-mem" && has_value) { index_mem_mb = std::max(1, atoi(argv[++i])); continue; }
+        if (a == "--min-wallets" && has_value) { min_wallets = std::max(1, atoi(argv[++i])); continue; }
+        args.emplace_back(argv[i]);
+    }
+
+    if (query_index) {
+        if (args.empty()) { print_usage(argv[0]); return 2; }
+        return query_wallet_index(query_index, args);
+    }
+    if (duplicates_index) return list_index_duplicates(duplicates_index, min_wallets);
+    if (index_out) {
+        for (const auto& a : args) {
+            struct stat st;
+            if (::stat(a.c_str(), &st) == 0 && S_ISDIR(st.st_mode)) {
+                size_t first = files.size();
+                if (!collect_dat_files(a.c_str(), a.back() == '/' ? a : a + "/", files)) return 1;
+                std::sort(files.begin() + first, files.end()); // Stable wallet ids across runs
+            } else {
+                files.push_back(a);
             }
-            std::string n(ep->d_name);
-            if (n.length() >= 4) {
-                std::string suffix = n.substr(n.length() - 4);
-                // Simple case-insensitive compare (might need better method on some systems)
-                if (strcasecmp(suffix.c_str(), ".dat") == 0) {
-
-                     files.push_back(n); // Add without stat check for simplicity
-                 }
+        }
+        if (files_from) {
+            std::ifstream list_file;
+            if (strcmp(files_from, "-") != 0) {
+                list_file.open(files_from);
+                if (!list_file) { std::cerr << "Error: Cannot open file list '" << files_from << "'." << std::endl; return 1; }
+            }
+            std::istream& list = strcmp(files_from, "-") == 0 ? std::cin : list_file;
+            std::string line;
+            while (std::getline(list, line)) {
+                if (!line.empty() && line.back() == '\r') line.pop_back();
+                if (!line.empty()) files.push_back(line);
             }
         }
-        closedir(dp);
+        if (args.empty() && !files_from && !collect_dat_files(".", "", files)) return 1;
+        if (files.empty()) { std::cerr << "Error: No wallet files to index." << std::endl; return 1; }
+        if (files.size() > INDEX_WALLET_MASK) { std::cerr << "Error: Too many wallets for one index (max " << INDEX_WALLET_MASK << ")." << std::endl; return 1; }
+        return build_wallet_index(files, index_out, threads, index_mem_mb); // One wallet per worker, parsed sequentially
+    }
+    g_parse_threads = threads;
+    // --- File finding logic ---
+    if (args.empty()) {
+        info_out() << "Info: No wallet file specified, scanning current directory for .dat files..." << std::endl;
+        if (!collect_dat_files(".", "", files)) return 1;
     } else {
-         std::cout << "Info: Processing files specified on command line." << std::endl;
-         for (int i = 1; i < argc; i++) { files.emplace_back(argv[i]); }
+         info_out() << "Info: Processing files specified on command line." << std::endl;
+         files = args;
     }
 
     if (files.empty()) {
-         std::cerr << "Error: No .dat wallet files found or specified.\nUsage: " << argv[0] << " [wallet_file1.dat ...]\n";
+         std::cerr << "Error: No .dat wallet files found or specified.\n";
+         print_usage(argv[0]);
          return 1;
     }
 
@@ -678,6 +1603,8 @@ int main(int argc, char* argv[]) {
         std::cout << "========================================\n";
         WalletDataMap data_map;
         DbSourceType source_type = DbSourceType::UNKNOWN;
+        DETAILS_PROBE(file_start, f.c_str());
+        auto file_started = std::chrono::steady_clock::now();
 
         // 1. Read all data (tries BDB then SQLite)
         bool read_success = choose_and_read_all_data(f.c_str(), data_map, source_type);
@@ -689,7 +1616,7 @@ int main(int argc, char* argv[]) {
              std::map<std::vector<uint8_t>, uint32_t> pubkey_timestamps;
              std::vector<AddressData> addresses;
 
-             bool parse_success = parse_data_from_map(data_map, source_type, mkey_data, keys, pubkey_timestamps, addresses);
+             bool parse_success = parse_data_from_map(data_map, mkey_data, keys, pubkey_timestamps, addresses);
              if (!parse_success) {
                   std::cerr << "Warning: Some records failed to parse for file '" << f << "'. Results may be incomplete." << std::endl;
              }
@@ -708,8 +1635,15 @@ int main(int argc, char* argv[]) {
              MKeyData mkey_data; std::vector<KeyData> keys; std::map<std::vector<uint8_t>, uint32_t> ts; std::vector<AddressData> addrs;
              print_info(f, mkey_data, keys, ts, addrs);
         }
+        DETAILS_PROBE(file_end, f.c_str(), static_cast<int>(read_success && !data_map.empty()),
+                      static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - file_started).count()));
     } // End loop over files
 
     std::cout << "\nAll specified files processed." << std::endl;
     return 0; // Indicate successful execution
 }
+#endif // WALLET_NO_MAIN
+
+#ifdef WALLET_NAMESPACE
+} // namespace WALLET_NAMESPACE
+#endif
@@ -0,0 +1,376 @@
+// Microbenchmarks for the per-record hot paths of wallet.cpp and wallet_Details.cpp
+// g++ -O2 -pthread -o wallet_bench wallet_bench.cpp libdb.a libsqlite3.a
+//
+// Both programs are compiled into this binary, each in its own namespace (hashx:: and details::, via
+// WALLET_NAMESPACE) and without its main() (WALLET_NO_MAIN), so the benchmarks call the real functions, not
+// copies. Each file includes its own headers outside the namespace. Records come from synthetic wallets with
+// the record mix of a legacy (ckey/keymeta/pool) and a descriptor (walletdescriptor*) wallet.
+#define WALLET_NO_MAIN
+#define WALLET_NAMESPACE hashx
+#include "wallet.cpp"
+#undef WALLET_NAMESPACE
+#define WALLET_NAMESPACE details
+#include "wallet_Details.cpp"
+#undef WALLET_NAMESPACE
+
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <vector>
+#include <string>
+#include <map>
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <memory>
+#include <new>
+#include <random>
+#include <cstdlib>
+
+// --- Allocation Counting ---
+// Every global new is counted, so allocs/record covers vectors, map nodes and strings alike.
+// Kept out of line so GCC doesn't pair an inlined malloc with std::free and warn (-Wmismatched-new-delete).
+static std::atomic<uint64_t> g_allocations(0);
+
+__attribute__((noinline)) void* operator new(size_t size) {
+    g_allocations.fetch_add(1, std::memory_order_relaxed);
+    if (void* p = std::malloc(size ? size : 1)) return p;
+    throw std::bad_alloc();
+}
+__attribute__((noinline)) void* operator new[](size_t size) { return ::operator new(size); }
+__attribute__((noinline)) void operator delete(void* p) noexcept { std::free(p); }
+__attribute__((noinline)) void operator delete[](void* p) noexcept { std::free(p); }
+__attribute__((noinline)) void operator delete(void* p, size_t) noexcept { std::free(p); }
+__attribute__((noinline)) void operator delete[](void* p, size_t) noexcept { std::free(p); }
+
+// --- Synthetic Wallets ---
+using Bytes = std::vector<uint8_t>;
+using Record = std::pair<Bytes, Bytes>;
+
+static void put_compact_size(Bytes& out, uint64_t n) {
+    if (n < 253) { out.push_back(static_cast<uint8_t>(n)); return; }
+    int width = n <= 0xffff ? 2 : (n <= 0xffffffffULL ? 4 : 8);
+    out.push_back(width == 2 ? 253 : (width == 4 ? 254 : 255));
+    for (int i = 0; i < width; ++i) out.push_back(static_cast<uint8_t>(n >> (8 * i)));
+}
+static void put_string(Bytes& out, const std::string& s) {
+    put_compact_size(out, s.size());
+    out.insert(out.end(), s.begin(), s.end());
+}
+static void put_blob(Bytes& out, std::mt19937& rng, size_t len, bool with_size) {
+    if (with_size) put_compact_size(out, len);
+    for (size_t i = 0; i < len; ++i) out.push_back(static_cast<uint8_t>(rng()));
+}
+static void put_uint32(Bytes& out, uint32_t v) { for (int i = 0; i < 4; ++i) out.push_back(static_cast<uint8_t>(v >> (8 * i))); }
+static void put_uint64(Bytes& out, uint64_t v) { for (int i = 0; i < 8; ++i) out.push_back(static_cast<uint8_t>(v >> (8 * i))); }
+
+static Record make_record(const std::string& type) { Record r; put_string(r.first, type); return r; }
+
+static Record make_mkey() {
+    Record r = make_record("mkey");
+    put_uint32(r.first, 1);
+    std::mt19937 rng(7);
+    put_blob(r.second, rng, 48, true);
+    put_blob(r.second, rng, 8, true);
+    put_uint32(r.second, 0);
+    put_uint32(r.second, 100000);
+    return r;
+}
+
+static std::string fake_address(std::mt19937& rng, const char* prefix, size_t len) {
+    static const char* alphabet = "123456789ABCDEFGHJKLMNPQRSTUVWXYZabcdefghijkmnopqrstuvwxyz";
+    std::string a = prefix;
+    while (a.size() < len) a += alphabet[rng() % 58];
+    return a;
+}
+
+// Legacy wallet: ckey + keymeta + pool per key, a name every 10 keys, transactions, and singleton records
+static std::vector<Record> legacy_wallet(size_t keys) {
+    std::mt19937 rng(1);
+    std::vector<Record> records;
+    records.push_back(make_mkey());
+    for (const char* t : {"version", "minversion"}) { Record r = make_record(t); put_uint32(r.second, 169900); records.push_back(r); }
+    { Record r = make_record("bestblock"); put_uint32(r.second, 169900); put_blob(r.second, rng, 32 * 20, true); records.push_back(r); }
+    { Record r = make_record("orderposnext"); put_uint64(r.second, keys); records.push_back(r); }
+    { Record r = make_record("hdchain"); put_uint32(r.second, 2); put_uint32(r.second, static_cast<uint32_t>(keys)); put_blob(r.second, rng, 20, false); put_uint32(r.second, 0); records.push_back(r); }
+    { Record r = make_record("defaultkey"); put_blob(r.second, rng, 33, true); records.push_back(r); }
+    for (size_t i = 0; i < keys; ++i) {
+        Bytes pubkey; put_blob(pubkey, rng, 33, true);
+        Record ck = make_record("ckey"); ck.first.insert(ck.first.end(), pubkey.begin(), pubkey.end()); put_blob(ck.second, rng, 48, true);
+        records.push_back(ck);
+        Record km = make_record("keymeta"); km.first.insert(km.first.end(), pubkey.begin(), pubkey.end());
+        put_uint32(km.second, 12); put_uint64(km.second, 1500000000 + i); put_string(km.second, "m/0'/0'/" + std::to_string(i) + "'"); put_blob(km.second, rng, 20, false);
+        records.push_back(km);
+        Record pool = make_record("pool"); put_uint64(pool.first, i);
+        put_uint32(pool.second, 169900); put_uint64(pool.second, 1500000000 + i); pool.second.insert(pool.second.end(), pubkey.begin(), pubkey.end());
+        records.push_back(pool);
+        if (i % 10 == 0) {
+            Record name = make_record("name"); put_string(name.first, fake_address(rng, "1", 34)); put_string(name.second, i % 20 ? "" : "savings");
+            records.push_back(name);
+        }
+        if (i % 5 == 0) {
+            Record tx = make_record("tx"); put_blob(tx.first, rng, 32, false); put_blob(tx.second, rng, 220 + rng() % 400, false);
+            records.push_back(tx);
+        }
+    }
+    return records;
+}
+
+// Descriptor wallet: descriptors with their caches and encrypted keys, bech32 names, transactions
+static std::vector<Record> descriptor_wallet(size_t keys) {
+    std::mt19937 rng(2);
+    std::vector<Record> records;
+    records.push_back(make_mkey());
+    for (const char* t : {"version", "minversion"}) { Record r = make_record(t); put_uint32(r.second, 210000); records.push_back(r); }
+    { Record r = make_record("bestblock_nomerkle"); put_uint32(r.second, 210000); put_compact_size(r.second, 0); records.push_back(r); }
+    { Record r = make_record("orderposnext"); put_uint64(r.second, keys); records.push_back(r); }
+    const size_t descriptors = 8;
+    std::vector<Bytes> ids(descriptors);
+    for (size_t d = 0; d < descriptors; ++d) {
+        put_blob(ids[d], rng, 32, false);
+        Record r = make_record("walletdescriptor"); r.first.insert(r.first.end(), ids[d].begin(), ids[d].end());
+        put_string(r.second, "wpkh([" + fake_address(rng, "", 8) + "/84h/0h/0h]" + fake_address(rng, "xpub", 111) + "/0/*)#" + fake_address(rng, "", 8));
+        put_uint64(r.second, 1600000000); put_uint32(r.second, 0); put_uint32(r.second, static_cast<uint32_t>(keys / descriptors)); put_uint32(r.second, 1000);
+        records.push_back(r);
+        Record spk = make_record("activeexternalspk"); put_uint32(spk.first, static_cast<uint32_t>(d)); spk.second = ids[d];
+        records.push_back(spk);
+    }
+    for (size_t i = 0; i < keys; ++i) {
+        const Bytes& id = ids[i % descriptors];
+        Bytes pubkey; put_blob(pubkey, rng, 33, true);
+        Record ck = make_record("walletdescriptorckey"); ck.first.insert(ck.first.end(), id.begin(), id.end());
+        ck.first.insert(ck.first.end(), pubkey.begin(), pubkey.end()); put_blob(ck.second, rng, 48, true);
+        records.push_back(ck);
+        Record cache = make_record("walletdescriptorcache"); cache.first.insert(cache.first.end(), id.begin(), id.end());
+        put_uint32(cache.first, 0); put_uint32(cache.first, static_cast<uint32_t>(i)); put_blob(cache.second, rng, 74, true);
+        records.push_back(cache);
+        if (i % 10 == 0) {
+            Record name = make_record("name"); put_string(name.first, fake_address(rng, "bc1q", 42)); put_string(name.second, "");
+            records.push_back(name);
+        }
+        if (i % 5 == 0) {
+            Record tx = make_record("tx"); put_blob(tx.first, rng, 32, false); put_blob(tx.second, rng, 180 + rng() % 300, false);
+            records.push_back(tx);
+        }
+    }
+    return records;
+}
+
+// --- Benchmark Runner ---
+struct BenchResult { std::string name; double ns_per_record = 0; double allocs_per_record = 0; uint64_t records = 0; };
+
+// Discards std::cout output from the parsers while timing
+class NullBuffer : public std::streambuf {
+protected:
+    int overflow(int c) override { return c; }
+    std::streamsize xsputn(const char*, std::streamsize n) override { return n; }
+};
+
+static volatile uint64_t g_sink = 0;
+
+// `body` processes one pass and returns the number of records it handled. Passes repeat until min_time has
+// elapsed; the best of `trials` runs is reported. Allocations are counted on a separate single pass.
+static BenchResult run_bench(const std::string& name, const std::function<uint64_t()>& body, double min_time_ms, int trials) {
+    BenchResult result; result.name = name;
+    body(); // Warm-up
+    uint64_t allocs_before = g_allocations.load(std::memory_order_relaxed);
+    uint64_t records = body();
+    result.records = records;
+    result.allocs_per_record = records ? double(g_allocations.load(std::memory_order_relaxed) - allocs_before) / records : 0;
+
+    double best = 0;
+    for (int t = 0; t < trials; ++t) {
+        uint64_t total = 0;
+        auto start = std::chrono::steady_clock::now();
+        double elapsed_ns = 0;
+        do {
+            total += body();
+            elapsed_ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+        } while (elapsed_ns < min_time_ms * 1e6);
+        double per = total ? elapsed_ns / total : 0;
+        if (t == 0 || per < best) best = per;
+    }
+    result.ns_per_record = best;
+    return result;
+}
+
+// Registers the benchmarks for one synthetic wallet
+static void add_wallet_benches(const std::string& tag, const std::vector<Record>& records, std::vector<std::pair<std::string, std::function<uint64_t()>>>& benches) {
+    auto map = std::make_shared<hashx::WalletDataMap>();
+    for (const auto& r : records) (*map)[r.first] = r.second;
+
+    // Every length prefix of the wallet, in record order, as one stream
+    auto sizes = std::make_shared<Bytes>();
+    uint64_t size_count = 0;
+    for (const auto& r : records) { put_compact_size(*sizes, r.first.size()); put_compact_size(*sizes, r.second.size()); size_count += 2; }
+
+    auto pubkeys = std::make_shared<std::vector<Bytes>>();
+    for (const auto& r : records) {
+        if (r.second.size() == 49 && r.first.size() >= 34) pubkeys->emplace_back(r.first.end() - 33, r.first.end());
+    }
+
+    benches.emplace_back("hashx.readCompactSize/" + tag, [sizes, size_count]() {
+        hashx::BCDataStream s; s.setInput(*sizes);
+        uint64_t acc = 0;
+        for (uint64_t i = 0; i < size_count; ++i) acc += s.readCompactSize();
+        g_sink += acc; return size_count;
+    });
+    benches.emplace_back("details.readCompactSize/" + tag, [sizes, size_count]() {
+        details::BCDataStream s; s.setInput(*sizes);
+        uint64_t acc = 0;
+        for (uint64_t i = 0; i < size_count; ++i) acc += s.readCompactSize();
+        g_sink += acc; return size_count;
+    });
+    benches.emplace_back("hashx.readStringWithCompactSize/" + tag, [map]() {
+        hashx::BCDataStream s; uint64_t acc = 0;
+        for (const auto& p : *map) { s.setInput(p.first); acc += s.readStringWithCompactSize().size(); }
+        g_sink += acc; return static_cast<uint64_t>(map->size());
+    });
+    benches.emplace_back("details.readStringWithCompactSize/" + tag, [map]() {
+        details::BCDataStream s; uint64_t acc = 0;
+        for (const auto& p : *map) { s.setInput(p.first); acc += s.readStringWithCompactSize().size(); }
+        g_sink += acc; return static_cast<uint64_t>(map->size());
+    });
+    benches.emplace_back("details.parse_data_from_map/" + tag, [map]() {
+        details::MKeyData mkey; std::vector<details::KeyData> keys;
+        std::map<std::vector<uint8_t>, uint32_t> timestamps; std::vector<details::AddressData> addresses;
+        details::parse_data_from_map(*map, mkey, keys, timestamps, addresses);
+        g_sink += keys.size() + addresses.size(); return static_cast<uint64_t>(map->size());
+    });
+    benches.emplace_back("hashx.find_and_parse_mkey/" + tag, [map]() {
+        hashx::MKeyData mkey;
+        g_sink += hashx::find_and_parse_mkey(*map, hashx::DbSourceType::BDB, mkey);
+        return static_cast<uint64_t>(map->size());
+    });
+    benches.emplace_back("hashx.map_insert/" + tag, [records]() {
+        hashx::WalletDataMap m;
+        hashx::RecordVisitor visit = hashx::map_inserter(m);
+        for (const auto& r : records) visit(r.first.data(), r.first.size(), r.second.data(), r.second.size());
+        g_sink += m.size(); return static_cast<uint64_t>(records.size());
+    });
+    benches.emplace_back("details.toHex/" + tag, [pubkeys]() {
+        uint64_t acc = 0;
+        for (const auto& k : *pubkeys) acc += details::toHex(k).size();
+        g_sink += acc; return static_cast<uint64_t>(pubkeys->size());
+    });
+    benches.emplace_back("details.toHex_sprintf/" + tag, [pubkeys]() {
+        uint64_t acc = 0;
+        for (const auto& k : *pubkeys) acc += details::toHex_sprintf(k).size();
+        g_sink += acc; return static_cast<uint64_t>(pubkeys->size());
+    });
+}
+
+// --- Baselines ---
+// TSV: name, ns/record, allocs/record
+static bool save_baseline(const char* path, const std::vector<BenchResult>& results) {
+    std::ofstream out(path, std::ios::trunc);
+    if (!out) return false;
+    out << "# wallet_bench baseline: name\tns_per_record\tallocs_per_record\n";
+    for (const auto& r : results) out << r.name << '\t' << std::fixed << std::setprecision(3) << r.ns_per_record << '\t' << r.allocs_per_record << '\n';
+    out.close();
+    return static_cast<bool>(out);
+}
+
+static bool load_baseline(const char* path, std::map<std::string, BenchResult>& baseline) {
+    std::ifstream in(path);
+    if (!in) return false;
+    std::string line;
+    while (std::getline(in, line)) {
+        if (line.empty() || line[0] == '#') continue;
+        std::istringstream fields(line);
+        BenchResult r;
+        if (std::getline(fields, r.name, '\t') && (fields >> r.ns_per_record >> r.allocs_per_record)) baseline[r.name] = r;
+    }
+    return true;
+}
+
+static void print_usage(const char* prog) {
+    std::cerr << "Usage: " << prog << " [options]\n"
+              << "Options:\n"
+              << "  --keys <n>              Keys per synthetic wallet (default: 2000)\n"
+              << "  --filter <text>         Only run benchmarks whose name contains <text>\n"
+              << "  --min-time-ms <n>       Minimum time per trial (default: 200)\n"
+              << "  --trials <n>            Trials per benchmark, best one is reported (default: 3)\n"
+              << "  --save-baseline <file>  Save the results as a baseline\n"
+              << "  --baseline <file>       Compare the results against a saved baseline\n"
+              << "  --fail-above <pct>      With --baseline, exit 1 if any ns/record regressed by more than <pct>%\n"
+              << "  -h, --help              Show this help\n";
+}
+
+// --- main function ---
+int main(int argc, char* argv[]) {
+    size_t keys = 2000;
+    std::string filter;
+    double min_time_ms = 200;
+    int trials = 3;
+    const char* save_path = nullptr;
+    const char* baseline_path = nullptr;
+    double fail_above = -1;
+
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg == "-h" || arg == "--help") { print_usage(argv[0]); return 0; }
+        else if (arg == "--keys" && i + 1 < argc) keys = std::max(1L, atol(argv[++i]));
+        else if (arg == "--filter" && i + 1 < argc) filter = argv[++i];
+        else if (arg == "--min-time-ms" && i + 1 < argc) min_time_ms = std::max(1.0, atof(argv[++i]));
+        else if (arg == "--trials" && i + 1 < argc) trials = std::max(1, atoi(argv[++i]));
+        else if (arg == "--save-baseline" && i + 1 < argc) save_path = argv[++i];
+        else if (arg == "--baseline" && i + 1 < argc) baseline_path = argv[++i];
+        else if (arg == "--fail-above" && i + 1 < argc) fail_above = atof(argv[++i]);
+        else {
+            std::cerr << "Error: Unknown or incomplete option '" << arg << "'" << std::endl;
+            print_usage(argv[0]);
+            return 1;
+        }
+    }
+
+    std::map<std::string, BenchResult> baseline;
+    if (baseline_path && !load_baseline(baseline_path, baseline)) {
+        std::cerr << "Error: Cannot read baseline '" << baseline_path << "'" << std::endl;
+        return 1;
+    }
+
+    std::vector<std::pair<std::string, std::function<uint64_t()>>> benches;
+    add_wallet_benches("legacy", legacy_wallet(keys), benches);
+    add_wallet_benches("descriptor", descriptor_wallet(keys), benches);
+
+    std::vector<BenchResult> results;
+    NullBuffer null_buffer;
+    for (const auto& b : benches) {
+        if (!filter.empty() && b.first.find(filter) == std::string::npos) continue;
+        std::streambuf* saved = std::cout.rdbuf(&null_buffer); // parse_data_from_map prints Info lines
+        BenchResult r = run_bench(b.first, b.second, min_time_ms, trials);
+        std::cout.rdbuf(saved);
+        results.push_back(r);
+
+        std::cout << std::left << std::setw(48) << r.name << std::right << std::fixed
+                  << std::setw(10) << std::setprecision(2) << r.ns_per_record << " ns/rec"
+                  << std::setw(8) << std::setprecision(2) << r.allocs_per_record << " allocs/rec";
+        auto it = baseline.find(r.name);
+        if (it != baseline.end() && it->second.ns_per_record > 0) {
+            double delta = 100.0 * (r.ns_per_record - it->second.ns_per_record) / it->second.ns_per_record;
+            std::cout << "   " << std::showpos << std::setprecision(1) << delta << "%" << std::noshowpos
+                      << " (was " << std::setprecision(2) << it->second.ns_per_record << " ns, "
+                      << it->second.allocs_per_record << " allocs)";
+        }
+        std::cout << std::endl;
+    }
+
+    if (save_path && !save_baseline(save_path, results)) {
+        std::cerr << "Error: Cannot write baseline '" << save_path << "'" << std::endl;
+        return 1;
+    }
+    if (baseline_path && fail_above >= 0) {
+        int regressions = 0;
+        for (const auto& r : results) {
+            auto it = baseline.find(r.name);
+            if (it == baseline.end() || it->second.ns_per_record <= 0) continue;
+            if (r.ns_per_record > it->second.ns_per_record * (1.0 + fail_above / 100.0)) regressions++;
+        }
+        if (regressions) {
+            std::cerr << "Error: " << regressions << " benchmark(s) regressed by more than " << fail_above << "%" << std::endl;
+            return 1;
+        }
+    }
+    return 0;
+}